@@ -0,0 +1,85 @@
+#include <cstring>
+#include <new>
+
+#include "arena.h"
+#include "mutex.h"
+#include "vector.h"
+
+static Mutex           arenas_lock;
+static Vector<Arena*>  arenas;
+static __thread Arena* thread_arena;
+
+Arena::Arena() : top_(0), end_(0)
+{
+	Lock l(arenas_lock);
+	arenas.push_back(this);
+}
+
+void* Arena::alloc(size_t size)
+{
+	size = align(size);
+	++stats_.n_objects;
+	stats_.used += size;
+
+	if (size > (size_t)(end_ - top_)) {
+		if (size > BLOCK_SIZE / 4) {
+			// Give large objects a block of their own and keep the current one.
+			++stats_.n_blocks;
+			stats_.reserved += size;
+			return ::operator new(size);
+		}
+
+		top_ = static_cast<char*>(::operator new(BLOCK_SIZE));
+		end_ = top_ + BLOCK_SIZE;
+		++stats_.n_blocks;
+		stats_.reserved += BLOCK_SIZE;
+	}
+
+	void* const p = top_;
+	top_ += size;
+	return p;
+}
+
+void Arena::release(void* const p, size_t size)
+{
+	size = align(size);
+	if (static_cast<char*>(p) + size != top_) return;
+
+	top_ = static_cast<char*>(p);
+	--stats_.n_objects;
+	stats_.used -= size;
+}
+
+char* Arena::strdup(char const* const s)
+{
+	size_t const size = std::strlen(s) + 1;
+	return static_cast<char*>(std::memcpy(alloc(size), s, size));
+}
+
+Arena& Arena::current()
+{
+	if (Arena* const a = thread_arena) return *a;
+
+	static Arena main_arena;
+	return main_arena;
+}
+
+void Arena::use_thread_arena()
+{
+	// Never freed, the objects outlive the thread.
+	thread_arena = new Arena();
+}
+
+Arena::Stats Arena::totals()
+{
+	Lock  l(arenas_lock);
+	Stats s;
+	for (Vector<Arena*>::const_iterator i = arenas.begin(), end = arenas.end(); i != end; ++i) {
+		Stats const& a = (*i)->stats_;
+		s.n_objects += a.n_objects;
+		s.used      += a.used;
+		s.reserved  += a.reserved;
+		s.n_blocks  += a.n_blocks;
+	}
+	return s;
+}
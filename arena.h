@@ -0,0 +1,64 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include "types.h"
+
+/* Bump pointer allocator for the objects built while parsing, which live
+ * until the end of the run.  Each thread allocates from its own arena, so no
+ * locking is needed.  Memory is only given back, if the most recent
+ * allocation is released again, which is what happens, when a Set rejects a
+ * freshly created duplicate. */
+class Arena
+{
+public:
+	struct Stats
+	{
+		Stats() : n_objects(), used(), reserved(), n_blocks() {}
+
+		size_t n_objects;
+		size_t used;
+		size_t reserved;
+		size_t n_blocks;
+	};
+
+	Arena();
+
+	void* alloc(size_t);
+
+	void release(void*, size_t);
+
+	char* strdup(char const*);
+
+	// The arena of the calling thread.
+	static Arena& current();
+
+	// Gives the calling thread an arena of its own.
+	static void use_thread_arena();
+
+	// Usage summed up over all arenas.
+	static Stats totals();
+
+private:
+	static size_t const BLOCK_SIZE = 1 << 20;
+
+	static size_t align(size_t const size) { return (size + sizeof(void*) - 1) & ~(sizeof(void*) - 1); }
+
+	char* top_;
+	char* end_;
+	Stats stats_;
+
+	Arena(Arena const&);           // No copy
+	void operator =(Arena const&); // No assignment
+};
+
+/* Base for types, which are allocated in the arena of the current thread.
+ * Deleting an object only releases its memory, if it was the most recent
+ * allocation of that arena. */
+struct ArenaObject
+{
+	static void* operator new(size_t const size) { return Arena::current().alloc(size); }
+
+	static void operator delete(void* const p, size_t const size) { Arena::current().release(p, size); }
+};
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef BENCH_BENCH_H
+#define BENCH_BENCH_H
+
+#include <cstddef>
+
+#include "../vector.h"
+
+// Seconds since an arbitrary point, for measuring intervals.
+double bench_now();
+
+/* Prints one result line.  bytes is the amount of data processed by all
+ * iterations together and may be 0, if throughput is meaningless. */
+void bench_report(char const* name, char const* variant, size_t iterations, size_t bytes, double seconds);
+
+/* Appends text resembling a deltatext to text, until it holds at least size
+ * bytes: lines of 0 to 79 characters without '@'.  The text is the same on
+ * every call. */
+void bench_make_text(Vector<u1>& text, size_t size);
+
+// Keeps the compiler from optimizing away a computed value.
+void bench_use(void const*);
+
+void bench_scan();
+void bench_lexer();
+void bench_set();
+void bench_blob();
+void bench_piecetable();
+void bench_date();
+void bench_text();
+void bench_heap();
+
+#endif
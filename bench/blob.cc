@@ -0,0 +1,32 @@
+#include "../blob.h"
+#include "bench.h"
+
+void bench_blob()
+{
+	size_t const total = 1 << 26; // Bytes hashed per variant
+
+	Vector<u1> text;
+	bench_make_text(text, 1 << 12);
+
+	// Symbols are short, logs and paths a bit longer.
+	static struct { char const* name; size_t size; } const sizes[] = {
+		{ "8 B",   8       },
+		{ "32 B",  32      },
+		{ "256 B", 256     },
+		{ "4 KiB", 1 << 12 }
+	};
+
+	for (size_t k = 0; k != sizeof(sizes) / sizeof(*sizes); ++k) {
+		size_t const size   = sizes[k].size;
+		size_t const rounds = total / size;
+
+		u4           h     = 0;
+		double const start = bench_now();
+		for (size_t r = 0; r != rounds; ++r) {
+			// Vary the start, so the hash cannot be hoisted out of the loop.
+			h += Blob::hash(text.begin() + (r & 63), size);
+		}
+		bench_report("Blob::hash", sizes[k].name, rounds, rounds * size, bench_now() - start);
+		bench_use(&h);
+	}
+}
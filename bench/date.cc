@@ -0,0 +1,54 @@
+#include <cstdio>
+
+#include "../date.h"
+#include "bench.h"
+
+void bench_date()
+{
+	size_t const n      = 1024;
+	size_t const rounds = 1024;
+
+	// Dates before 2000 have a two-digit year in RCS files.
+	Vector<Blob*> dates;
+	for (size_t i = 0; i != n; ++i) {
+		char buf[32];
+		if (i % 2 == 0) {
+			std::sprintf(buf, "%02u.%02u.%02u.%02u.%02u.%02u", (unsigned)(90 + i % 10), (unsigned)(1 + i % 12), (unsigned)(1 + i % 28), (unsigned)(i % 24), (unsigned)(i % 60), (unsigned)(i * 7 % 60));
+		} else {
+			std::sprintf(buf, "%04u.%02u.%02u.%02u.%02u.%02u", (unsigned)(2000 + i % 20), (unsigned)(1 + i % 12), (unsigned)(1 + i % 28), (unsigned)(i % 24), (unsigned)(i % 60), (unsigned)(i * 7 % 60));
+		}
+		dates.push_back(Blob::alloc(buf));
+	}
+
+	Vector<Date> parsed;
+	{
+		double const start = bench_now();
+		for (size_t r = 0; r != rounds; ++r) {
+			for (size_t i = 0; i != n; ++i) {
+				Date const d = Date::parse(dates[i]);
+				bench_use(&d);
+			}
+		}
+		bench_report("Date::parse", "", rounds * n, 0, bench_now() - start);
+	}
+
+	for (size_t i = 0; i != n; ++i) {
+		parsed.push_back(Date::parse(dates[i]));
+	}
+
+	{
+		u4           sum   = 0;
+		double const start = bench_now();
+		for (size_t r = 0; r != rounds; ++r) {
+			for (size_t i = 0; i != n; ++i) {
+				sum += parsed[i].seconds();
+			}
+			bench_use(&sum);
+		}
+		bench_report("Date::seconds", "", rounds * n, 0, bench_now() - start);
+	}
+
+	for (Vector<Blob*>::const_iterator i = dates.begin(), end = dates.end(); i != end; ++i) {
+		delete *i;
+	}
+}
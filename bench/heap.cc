@@ -0,0 +1,39 @@
+#include <cstdlib>
+
+#include "../heap.h"
+#include "bench.h"
+
+// Pushes all keys and pops them again, like the topological sort.
+template<size_t D> static void push_pop(char const* const variant, Vector<u4> const& keys, size_t const rounds)
+{
+	double const start = bench_now();
+	for (size_t r = 0; r != rounds; ++r) {
+		Heap<u4, std::less<u4>, D> h;
+		for (Vector<u4>::const_iterator i = keys.begin(), end = keys.end(); i != end; ++i) {
+			h.push(*i);
+		}
+		u4 sum = 0;
+		while (!h.empty()) {
+			sum += h.front();
+			h.pop();
+		}
+		bench_use(&sum);
+	}
+	bench_report("Heap push+pop", variant, rounds * keys.size(), 0, bench_now() - start);
+}
+
+void bench_heap()
+{
+	size_t const n      = 1 << 16;
+	size_t const rounds = 16;
+
+	Vector<u4> keys;
+	std::srand(1);
+	for (size_t i = 0; i != n; ++i) {
+		keys.push_back(std::rand());
+	}
+
+	push_pop<2>("D=2", keys, rounds);
+	push_pop<4>("D=4", keys, rounds);
+	push_pop<8>("D=8", keys, rounds);
+}
@@ -0,0 +1,99 @@
+#include <cstdio>
+#include <cstring>
+
+#include "../lexer.h"
+#include "bench.h"
+
+static void append(Vector<u1>& v, u1 const* i, u1 const* const end)
+{
+	for (; i != end; ++i) {
+		v.push_back(*i);
+	}
+}
+
+static void append(Vector<u1>& v, char const* const s)
+{
+	append(v, (u1 const*)s, (u1 const*)s + std::strlen(s));
+}
+
+/* A ,v file with a trunk of n_revs revisions: the admin section, a delta
+ * entry per revision and the deltatexts, each a small diff script.  Returns
+ * the number of strings in it. */
+static size_t make_rcs_file(Vector<u1>& v, u4 const n_revs)
+{
+	char buf[256];
+	append(v, "head\t1.");
+	std::sprintf(buf, "%u;\naccess;\nsymbols\n\tRELEASE_1:1.2\n\tRELEASE_0:1.1;\nlocks; strict;\ncomment\t@# @;\n\n\n", n_revs);
+	append(v, buf);
+
+	for (u4 r = n_revs; r != 0; --r) {
+		std::sprintf(buf, "1.%u\ndate\t2001.09.%02u.15.15.37;\tauthor joe;\tstate Exp;\nbranches;\nnext\t", r, 1 + r % 28);
+		append(v, buf);
+		if (r != 1) std::sprintf(buf, "1.%u;\n\n", r - 1);
+		else        std::sprintf(buf, ";\n\n");
+		append(v, buf);
+	}
+
+	append(v, "\ndesc\n@@\n\n");
+
+	Vector<u1> text;
+	bench_make_text(text, 1 << 12);
+	for (u4 r = n_revs; r != 0; --r) {
+		std::sprintf(buf, "\n1.%u\nlog\n@Fix the frobnicator, mail joe@@example.org\n@\ntext\n@", r);
+		append(v, buf);
+		if (r == n_revs) {
+			append(v, text.begin(), text.end());
+		} else {
+			std::sprintf(buf, "d%u 2\na%u 2\n", r, r + 1);
+			append(v, buf);
+			u1 const* const line = text.begin() + (r * 97) % (text.size() - 160);
+			append(v, line, line + 160);
+		}
+		append(v, "@\n");
+	}
+	return 2 + 2 * n_revs; // comment, desc, log and text
+}
+
+// Every token up to a string.
+static void skip_tokens(Lexer& l)
+{
+	while (l.accept(T_ID) || l.accept(T_NUM) || l.accept(T_COLON) || l.accept(T_SEMICOLON)) {}
+}
+
+void bench_lexer()
+{
+	size_t const rounds = 64;
+
+	Vector<u1> file;
+	size_t const n_strings = make_rcs_file(file, 2000);
+	u1 const* const begin = file.begin();
+	u1 const* const end   = file.end();
+
+	{
+		double const start = bench_now();
+		for (size_t r = 0; r != rounds; ++r) {
+			Lexer l(begin, end);
+			for (size_t n = n_strings; n != 0; --n) {
+				skip_tokens(l);
+				l.skip(T_STRING);
+			}
+			l.expect(T_EOF);
+		}
+		bench_report("Lexer", "skip", rounds, rounds * file.size(), bench_now() - start);
+	}
+
+	{
+		double const start = bench_now();
+		for (size_t r = 0; r != rounds; ++r) {
+			Lexer l(begin, end);
+			for (size_t n = n_strings; n != 0; --n) {
+				skip_tokens(l);
+				Blob* const text = l.expect_text();
+				bench_use(text);
+				delete text;
+			}
+			l.expect(T_EOF);
+		}
+		bench_report("Lexer", "text", rounds, rounds * file.size(), bench_now() - start);
+	}
+}
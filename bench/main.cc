@@ -0,0 +1,50 @@
+#include <cstdio>
+#include <cstdlib>
+#include <time.h>
+
+#include "bench.h"
+
+double bench_now()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+void bench_report(char const* const name, char const* const variant, size_t const iterations, size_t const bytes, double const seconds)
+{
+	std::printf("%-24s %-8s %12.1f ns/op", name, variant, seconds * 1e9 / iterations);
+	if (bytes != 0) std::printf(" %10.1f MB/s", bytes / seconds / 1e6);
+	std::printf("\n");
+}
+
+void bench_make_text(Vector<u1>& text, size_t const size)
+{
+	std::srand(1);
+	while (text.size() < size) {
+		for (int n = std::rand() % 80; n != 0; --n) {
+			text.push_back(' ' + std::rand() % 32);
+		}
+		text.push_back('\n');
+	}
+}
+
+void const* volatile bench_sink;
+
+void bench_use(void const* const p)
+{
+	bench_sink = p;
+}
+
+int main()
+{
+	bench_scan();
+	bench_lexer();
+	bench_set();
+	bench_blob();
+	bench_piecetable();
+	bench_date();
+	bench_text();
+	bench_heap();
+	return 0;
+}
@@ -0,0 +1,70 @@
+#include <cstdio>
+
+#include "../piecetable.h"
+#include "bench.h"
+
+/* A diff script like the deltatexts of a busy file: one line in every step
+ * lines is replaced by two new ones, taken from text. */
+static Blob* make_script(Vector<u1> const& text, size_t const n_lines, size_t const step)
+{
+	BlobBuilder     b;
+	u1 const*       line = text.begin();
+	u1 const* const end  = text.end();
+	for (size_t l = step; l <= n_lines; l += step) {
+		char buf[64];
+		int  const n = std::sprintf(buf, "d%lu 1\na%lu 2\n", (unsigned long)l, (unsigned long)l);
+		for (int i = 0; i != n; ++i) {
+			b.add_byte(buf[i]);
+		}
+		for (int k = 0; k != 2; ++k) {
+			if (line == end) line = text.begin();
+			do b.add_byte(*line); while (*line++ != '\n');
+		}
+	}
+	return b.get();
+}
+
+void bench_piecetable()
+{
+	size_t const rounds = 256;
+
+	// A source file of about 4000 lines.
+	Vector<u1> text;
+	bench_make_text(text, 160 << 10);
+	Blob* const file = Blob::alloc(text.begin(), text.size());
+
+	size_t n_lines = 0;
+	for (u1 const* i = file->begin(); i != file->end(); ++i) {
+		if (*i == '\n') ++n_lines;
+	}
+
+	{
+		PieceTable   p;
+		double const start = bench_now();
+		for (size_t r = 0; r != rounds; ++r) {
+			p.set(*file);
+		}
+		bench_report("PieceTable::set", "", rounds, rounds * file->size, bench_now() - start);
+		bench_use(&p);
+	}
+
+	static struct { char const* name; size_t step; } const scripts[] = {
+		{ "sparse", 500 },
+		{ "dense",  10  }
+	};
+
+	PieceTable const src(*file);
+	for (size_t k = 0; k != sizeof(scripts) / sizeof(*scripts); ++k) {
+		Blob* const  script = make_script(text, n_lines, scripts[k].step);
+		PieceTable   p;
+		double const start  = bench_now();
+		for (size_t r = 0; r != rounds; ++r) {
+			p.modify(src, *script);
+		}
+		// The throughput is that of the produced content.
+		bench_report("PieceTable::modify", scripts[k].name, rounds, rounds * p.size(), bench_now() - start);
+		delete script;
+	}
+
+	delete file;
+}
@@ -0,0 +1,42 @@
+#include "../scan.h"
+#include "../vector.h"
+#include "bench.h"
+
+void bench_scan()
+{
+	size_t const size   = 1 << 22;
+	size_t const rounds = 64;
+
+	Vector<u1> text;
+	bench_make_text(text, size);
+	text.push_back('@');
+	u1 const* const begin = text.begin();
+	u1 const* const end   = text.end();
+
+	for (ScanKernel const* const* i = scan_kernels; *i; ++i) {
+		ScanKernel const& k = **i;
+
+		double const start = bench_now();
+		for (size_t r = 0; r != rounds; ++r) {
+			bench_use(k.find_byte(begin, end, '@'));
+		}
+		bench_report("find_byte '@'", k.name, rounds, rounds * text.size(), bench_now() - start);
+	}
+
+	for (ScanKernel const* const* i = scan_kernels; *i; ++i) {
+		ScanKernel const& k = **i;
+
+		double const start = bench_now();
+		for (size_t r = 0; r != rounds; ++r) {
+			u1 const* ends[64];
+			u1 const* p = begin;
+			for (;;) {
+				size_t const n = k.split_lines(p, end, ends, 64);
+				if (n != 64) break;
+				p = ends[63];
+			}
+			bench_use(p);
+		}
+		bench_report("split_lines", k.name, rounds, rounds * text.size(), bench_now() - start);
+	}
+}
@@ -0,0 +1,85 @@
+#include <cstdio>
+
+#include "../blob.h"
+#include "../set.h"
+#include "bench.h"
+
+// Keys resembling paths of ,v files.
+static void make_keys(Vector<Blob*>& keys, u4 const first, u4 const n)
+{
+	for (u4 i = first; i != first + n; ++i) {
+		char buf[64];
+		std::sprintf(buf, "src/module%03u/file%06u.c,v", i % 997, i);
+		keys.push_back(Blob::alloc(buf));
+	}
+}
+
+static void free_keys(Vector<Blob*>& keys)
+{
+	for (Vector<Blob*>::const_iterator i = keys.begin(), end = keys.end(); i != end; ++i) {
+		delete *i;
+	}
+}
+
+void bench_set()
+{
+	size_t const capacity = 1 << 17;
+	size_t const rounds   = 16;
+
+	Vector<Blob*> keys;
+	Vector<Blob*> missing;
+	make_keys(keys,    0,        capacity / 2);
+	make_keys(missing, capacity, capacity / 2);
+
+	{
+		double const start = bench_now();
+		for (size_t r = 0; r != rounds; ++r) {
+			Set<Blob*> s;
+			for (Vector<Blob*>::const_iterator i = keys.begin(), end = keys.end(); i != end; ++i) {
+				s.insert(*i);
+			}
+			bench_use(&s);
+		}
+		bench_report("Set::insert", "grow", rounds * keys.size(), 0, bench_now() - start);
+	}
+
+	/* The table doubles, when it becomes half full, so the load factor is
+	 * between 25% and 50%.  The sizes are chosen so all tables have the same
+	 * capacity. */
+	static struct { char const* name; size_t size; } const loads[] = {
+		{ "26%", capacity / 4 + 1 },
+		{ "38%", capacity * 3 / 8 },
+		{ "50%", capacity / 2     }
+	};
+
+	for (size_t k = 0; k != sizeof(loads) / sizeof(*loads); ++k) {
+		size_t const n = loads[k].size;
+		Set<Blob*>   s;
+		for (size_t i = 0; i != n; ++i) {
+			s.insert(keys[i]);
+		}
+
+		{
+			double const start = bench_now();
+			for (size_t r = 0; r != rounds; ++r) {
+				for (size_t i = 0; i != n; ++i) {
+					bench_use(s.find(keys[i]));
+				}
+			}
+			bench_report("Set::find hit", loads[k].name, rounds * n, 0, bench_now() - start);
+		}
+
+		{
+			double const start = bench_now();
+			for (size_t r = 0; r != rounds; ++r) {
+				for (size_t i = 0; i != n; ++i) {
+					bench_use(s.find(missing[i]));
+				}
+			}
+			bench_report("Set::find miss", loads[k].name, rounds * n, 0, bench_now() - start);
+		}
+	}
+
+	free_keys(keys);
+	free_keys(missing);
+}
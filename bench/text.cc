@@ -0,0 +1,88 @@
+#include <cstring>
+
+#include "../text.h"
+#include "bench.h"
+
+static void append(Vector<u1>& v, char const* s)
+{
+	for (; *s != '\0'; ++s) {
+		v.push_back(*s);
+	}
+}
+
+void bench_text()
+{
+	size_t const rounds = 64;
+
+	// The default keywords of cvscvt.
+	Vector<char const*> keywords;
+	keywords.push_back("Author");
+	keywords.push_back("Date");
+	keywords.push_back("Header");
+	keywords.push_back("Id");
+	keywords.push_back("Locker");
+	keywords.push_back("Log");
+	keywords.push_back("Name");
+	keywords.push_back("RCSfile");
+	keywords.push_back("Revision");
+	keywords.push_back("Source");
+	keywords.push_back("State");
+
+	// A source file with an expanded keyword every 40 lines.
+	Vector<u1> lines;
+	bench_make_text(lines, 1 << 20);
+	Vector<u1> text;
+	size_t     n_lines = 0;
+	for (u1 const* i = lines.begin(); i != lines.end(); ++i) {
+		text.push_back(*i);
+		if (*i == '\n' && ++n_lines % 40 == 0) {
+			append(text, "/* $Id: file.c,v 1.42 2001/09/09 15:15:37 joe Exp $ */\n");
+		}
+	}
+	Blob* const file = Blob::alloc(text.begin(), text.size());
+
+	{
+		double const start = bench_now();
+		for (size_t r = 0; r != rounds; ++r) {
+			Blob* const b = unexpand(file, keywords);
+			bench_use(b);
+			delete b;
+		}
+		bench_report("unexpand", "", rounds, rounds * file->size, bench_now() - start);
+	}
+
+	/* Log messages with trailing whitespace, empty lines and both UTF-8 and
+	 * Latin-1 umlauts. */
+	static char const* const logs[] = {
+		"Fix the frobnicator.\n",
+		"Fix the frobnicator.  \n\n\n",
+		"\n\nMerge from the release branch:\n\n\n  - fix a crash on startup\t\n  - update the manual\n\n",
+		"Corrected the spelling of M\xC3\xBCller.\n",
+		"Corrected the spelling of M\xFCller.\r\n"
+	};
+	size_t const n_logs = sizeof(logs) / sizeof(*logs);
+
+	Vector<Blob*> blobs;
+	size_t        bytes = 0;
+	for (size_t i = 0; i != 1024; ++i) {
+		blobs.push_back(Blob::alloc(logs[i % n_logs]));
+		bytes += std::strlen(logs[i % n_logs]);
+	}
+
+	{
+		double const start = bench_now();
+		for (size_t r = 0; r != rounds; ++r) {
+			for (Vector<Blob*>::const_iterator i = blobs.begin(), end = blobs.end(); i != end; ++i) {
+				Blob* const b = convert_log(**i);
+				bench_use(b);
+				delete b;
+			}
+		}
+		bench_report("convert_log", "", rounds * blobs.size(), rounds * bytes, bench_now() - start);
+	}
+
+	for (Vector<Blob*>::const_iterator i = blobs.begin(), end = blobs.end(); i != end; ++i) {
+		delete *i;
+	}
+	delete file;
+}
@@ -1,9 +1,13 @@
 #ifndef BLOB_H
 #define BLOB_H
 
+#include <new>
 #include <ostream>
 #include <cstring>
 
+#include "arena.h"
+#include "memstats.h"
+#include "output.h"
 #include "types.h"
 
 struct Blob
@@ -27,12 +31,26 @@ struct Blob
 		return new(size) Blob((u1 const*)str, size);
 	}
 
+	static Blob* alloc(u1 const* const data, size_t const size)
+	{
+		return new(size) Blob(data, size);
+	}
+
+	// A Blob allocated this way must not be deleted.
+	static Blob* alloc(Arena& a, u1 const* const data, size_t const size)
+	{
+		mem_count(MEM_SYMBOLS, sizeof(Blob) + size, 1);
+		return ::new(a.alloc(sizeof(Blob) + size)) Blob(data, size);
+	}
+
 	void append(u1 const c)
 	{
 		data[size++] = c;
 	}
 
-	u4 hash() const
+	u4 hash() const { return hash(data, size); }
+
+	static u4 hash(u1 const* const data, size_t const size)
 	{
 		u4 hash = 2166136261U;
 
@@ -69,11 +87,43 @@ static inline bool operator ==(Blob const& a, Blob const& b)
 	return a.size == b.size && memcmp(a.data, b.data, a.size) == 0;
 }
 
+/* Unowned byte range, which compares equal to a Blob with the same contents.
+ * Used to look up a Blob in a Set without allocating one. */
+struct BlobRef
+{
+	BlobRef(u1 const* const data, size_t const size) :
+		data(data),
+		size(size),
+		hash_(Blob::hash(data, size))
+	{}
+
+	u4 hash() const { return hash_; }
+
+	Blob* create() const { return Blob::alloc(Arena::current(), data, size); }
+
+	u1 const* data;
+	size_t    size;
+
+private:
+	u4 hash_;
+};
+
+static inline bool operator ==(Blob const& a, BlobRef const& b)
+{
+	return a.size == b.size && memcmp(a.data, b.data, a.size) == 0;
+}
+
 static inline std::ostream& operator <<(std::ostream& o, Blob const& b)
 {
 	return o.write(reinterpret_cast<char const*>(b.data), b.size);
 }
 
+static inline Output& operator <<(Output& o, Blob const& b)
+{
+	o.write(b.data, b.size);
+	return o;
+}
+
 class BlobBuilder
 {
 public:
@@ -0,0 +1,83 @@
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <unistd.h>
+
+#include "checkpoint.h"
+#include "output.h"
+#include "parsecache.h"
+
+static char const magic[] = "cvscvt checkpoint 1\n";
+
+static size_t const magic_size = sizeof(magic) - 1;
+
+static void put_progress(RecordWriter& w, Progress const& p)
+{
+	w.put<u8>(p.position);
+	w.put<u8>(p.n_commits);
+	w.put<u8>(p.n_tags);
+	w.put<u4>(p.mark);
+	w.put<u4>(p.trunk_tip);
+}
+
+size_t const CheckpointReader::header_size = magic_size + 3 * sizeof(u8) + 2 * sizeof(u4);
+
+CheckpointWriter::CheckpointWriter(char const* const path, std::string const& snapshot) :
+	fd_(open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666))
+{
+	if (fd_ < 0) throw std::runtime_error("cannot create checkpoint");
+
+	try {
+		RecordWriter w;
+		put_progress(w, Progress());
+
+		Output out(fd_);
+		out.write(magic, magic_size);
+		out.write(w.data().data(), w.data().size());
+		out.write(snapshot.data(), snapshot.size());
+		out.flush();
+		if (fsync(fd_) != 0) throw std::runtime_error("cannot write checkpoint");
+	} catch (...) {
+		close(fd_);
+		throw;
+	}
+}
+
+CheckpointWriter::CheckpointWriter(char const* const path) :
+	fd_(open(path, O_WRONLY))
+{
+	if (fd_ < 0) throw std::runtime_error("cannot open checkpoint");
+}
+
+CheckpointWriter::~CheckpointWriter()
+{
+	close(fd_);
+}
+
+void CheckpointWriter::save(Progress const& p)
+{
+	RecordWriter w;
+	put_progress(w, p);
+	std::string const& d = w.data();
+	if (pwrite(fd_, d.data(), d.size(), magic_size) != (ssize_t)d.size() || fsync(fd_) != 0) {
+		throw std::runtime_error("cannot write checkpoint");
+	}
+}
+
+CheckpointReader::CheckpointReader(char const* const path) :
+	file_(path)
+{
+	if (file_.size() < header_size || memcmp(file_.begin(), magic, magic_size) != 0) {
+		throw std::runtime_error("not a checkpoint file");
+	}
+
+	RecordReader r(file_.begin() + magic_size, begin());
+	progress_.position  = r.get<u8>();
+	progress_.n_commits = r.get<u8>();
+	progress_.n_tags    = r.get<u8>();
+	progress_.mark      = r.get<u4>();
+	progress_.trunk_tip = r.get<u4>();
+	if (progress_.position == Progress::NONE) {
+		throw std::runtime_error("checkpoint records no progress yet, the conversion has to start over");
+	}
+}
@@ -0,0 +1,75 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <string>
+
+#include "mappedfile.h"
+#include "types.h"
+
+// How far the emission got.
+struct Progress
+{
+	Progress() : position(NONE), n_commits(), n_tags(), mark(), trunk_tip() {}
+
+	Progress(u8 const position, u8 const n_commits, u8 const n_tags, u4 const mark, u4 const trunk_tip) :
+		position(position),
+		n_commits(n_commits),
+		n_tags(n_tags),
+		mark(mark),
+		trunk_tip(trunk_tip)
+	{}
+
+	u8 position; // Number of changesets done
+	u8 n_commits;
+	u8 n_tags;
+	u4 mark;
+	u4 trunk_tip;
+
+	static u8 const NONE = ~0ULL;
+};
+
+/* A checkpoint file holds the progress and a snapshot of everything needed to
+ * continue the emission from there.  The progress is rewritten in place, the
+ * snapshot is written only once. */
+class CheckpointWriter
+{
+public:
+	// The file records no progress until the first save().
+	CheckpointWriter(char const* path, std::string const& snapshot);
+
+	// Continues to record the progress in an existing checkpoint file.
+	CheckpointWriter(char const* path);
+
+	~CheckpointWriter();
+
+	// The progress is on disk, when this returns.
+	void save(Progress const&);
+
+private:
+	int fd_;
+
+	CheckpointWriter(CheckpointWriter const&); // No copy
+	void operator =(CheckpointWriter const&);  // No assignment
+};
+
+class CheckpointReader
+{
+public:
+	CheckpointReader(char const* path);
+
+	Progress const& progress() const { return progress_; }
+
+	u1 const* begin() const { return file_.begin() + header_size; }
+	u1 const* end()   const { return file_.end(); }
+
+	static size_t const header_size;
+
+private:
+	MappedFile file_;
+	Progress   progress_;
+
+	CheckpointReader(CheckpointReader const&); // No copy
+	void operator =(CheckpointReader const&);  // No assignment
+};
+
+#endif
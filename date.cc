@@ -98,3 +98,14 @@ std::ostream& operator <<(std::ostream& o, Date const& d)
 		<<            (u4)d.year << '.' << setw(2) << (u4)d.month  << '.' << setw(2) << (u4)d.day << ' '
 		<< setw(2) << (u4)d.hour << ':' << setw(2) << (u4)d.minute << ':' << setw(2) << (u4)d.second;
 }
+
+Output& operator <<(Output& o, Date const& d)
+{
+	o.number(d.year);
+	o << '.'; o.number(d.month,  2);
+	o << '.'; o.number(d.day,    2);
+	o << ' '; o.number(d.hour,   2);
+	o << ':'; o.number(d.minute, 2);
+	o << ':'; o.number(d.second, 2);
+	return o;
+}
@@ -59,5 +59,6 @@ static inline bool operator !=(Date const& a, Date const& b)
 }
 
 std::ostream& operator <<(std::ostream&, Date const&);
+Output&       operator <<(Output&,       Date const&);
 
 #endif
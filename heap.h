@@ -1,15 +1,17 @@
 #ifndef HEAP_H
 #define HEAP_H
 
+#include <functional>
+
 #include "vector.h"
 
-template<typename T, typename U = bool(T const&, T const&)> class Heap
+/* Heap with the largest element according to Less at the front.  Each node
+ * has D children; a larger D makes the heap flatter, so pop() touches fewer
+ * cache lines at the cost of more comparisons per level. */
+template<typename T, typename Less = std::less<T>, size_t D = 2> class Heap
 {
-	private:
-		static bool default_compare(T const& a, T  const& b) { return a < b; }
-
 	public:
-		Heap(U& compare = default_compare) : compare_(compare) {}
+		Heap(Less const& less = Less()) : less_(less) {}
 
 		void push(T const& v);
 		void pop();
@@ -23,16 +25,16 @@ template<typename T, typename U = bool(T const&, T const&)> class Heap
 
 	private:
 		Vector<T> heap_;
-		U&        compare_;
+		Less      less_;
 };
 
-template<typename T, typename U> void Heap<T, U>::push(T const& v)
+template<typename T, typename Less, size_t D> void Heap<T, Less, D>::push(T const& v)
 {
 	size_t dst = heap_.size();
 	heap_.push_back(v);
 	for (; dst != 0;) {
-		size_t parent = (dst - 1) / 2;
-		if (compare_(v, heap_[parent]))
+		size_t parent = (dst - 1) / D;
+		if (less_(v, heap_[parent]))
 			break;
 
 		heap_[dst] = heap_[parent];
@@ -41,30 +43,27 @@ template<typename T, typename U> void Heap<T, U>::push(T const& v)
 	heap_[dst] = v;
 }
 
-template<typename T, typename U> void Heap<T, U>::pop()
+template<typename T, typename Less, size_t D> void Heap<T, Less, D>::pop()
 {
 	T v = heap_.back();
 	heap_.pop_back();
-	size_t src  = 0;
-	size_t size = heap_.size();
+	size_t       src  = 0;
+	size_t const size = heap_.size();
 	if (size != 0) {
 		for (;;) {
-			size_t const left = src * 2 + 1;
-			if (size <= left)
-				break;
-			size_t const right = src * 2 + 2;
-			if (compare_(v, heap_[left])) {
-				if (right < size && compare_(heap_[left], heap_[right]))
-					goto right;
-				heap_[src] = heap_[left];
-				src = left;
-			} else if (right < size && compare_(v, heap_[right])) {
-right:
-				heap_[src] = heap_[right];
-				src = right;
-			} else {
+			size_t const first = src * D + 1;
+			if (size <= first)
 				break;
+			size_t const last = first + D < size ? first + D : size;
+			size_t       max  = first;
+			for (size_t i = first + 1; i != last; ++i) {
+				if (less_(heap_[max], heap_[i]))
+					max = i;
 			}
+			if (!less_(v, heap_[max]))
+				break;
+			heap_[src] = heap_[max];
+			src = max;
 		}
 		heap_[src] = v;
 	}
@@ -1,15 +1,25 @@
+#include <sstream>
 #include <stdexcept>
 
 #include "lexer.h"
-#include "set.h"
-
-
-Lexer::Lexer(FILE* const f) : f_(f), line_(1), col_(0)
+#include "scan.h"
+#include "sharedset.h"
+
+
+Lexer::Lexer(u1 const* const begin, u1 const* const end) :
+	begin_(begin),
+	end_(end),
+	cur_(begin),
+	tok_(begin),
+	blob_(),
+	str_begin_(),
+	str_end_(),
+	str_escaped_()
 {
 	next();
 }
 
-struct LexerBlobs : public Set<Blob*>
+struct LexerBlobs : public SharedSet<Blob*>
 {
 	LexerBlobs() :
 		sym_colon(    insert(Blob::alloc(":"))),
@@ -22,9 +32,17 @@ struct LexerBlobs : public Set<Blob*>
 
 static LexerBlobs texts;
 
+static Blob* hash_find(u1 const* const data, size_t const size)
+{
+	return texts.find_or_insert(BlobRef(data, size));
+}
+
+// Interns a copy in the arena; the slack of the builder is not kept.
 static Blob* hash_find(Blob* const b)
 {
-	return texts.insert(b);
+	Blob* const res = hash_find(b->data, b->size);
+	delete b;
+	return res;
 }
 
 static inline bool is_num_char(int const c)
@@ -39,35 +57,45 @@ static inline bool is_visible_char(int const c)
 		(0xA0 <= c && c <= 0xFF);
 }
 
-int Lexer::read_char()
+u4 Lexer::line() const
+{
+	u4 line = 1;
+	for (u1 const* i = begin_; i != tok_; ++i) {
+		if (*i == '\n') ++line;
+	}
+	return line;
+}
+
+u4 Lexer::col() const
 {
-	int const c = fgetc(f_);
-	if (c == EOF && !feof(f_))
-		throw std::runtime_error("read failed");
-	++col_;
-	return c;
+	u1 const* i = tok_;
+	while (i != begin_ && i[-1] != '\n') --i;
+	return tok_ - i + 1;
 }
 
-void Lexer::unget_char(int const c)
+void Lexer::error(char const* const msg) const
 {
-	--col_;
-	ungetc(c, f_);
+	std::ostringstream s;
+	s << msg << " at line " << line() << ", column " << col();
+	throw std::runtime_error(s.str());
 }
 
 void Lexer::next()
 {
 	blob_ = 0;
 
+	u1 const* i = cur_;
 	for (;;) {
-		int c = read_char();
-		colstart_ = col_;
-		switch (c) {
-			case EOF: kind_ = T_EOF; return;
+		tok_ = i;
+		if (i == end_) {
+			kind_ = T_EOF;
+			cur_  = i;
+			return;
+		}
 
+		int c = *i++;
+		switch (c) {
 			case '\n': // LF line feed
-				++line_;
-				col_ = 0;
-				/* FALLTHROUGH */
 			case '\b': // BS backspace
 			case '\t': // HT horizontal tabulator
 			case '\v': // VT vertical tabulator
@@ -80,64 +108,70 @@ void Lexer::next()
 			case '$': return T_DOLLAR;
 			case ',': return T_COMMA;
 #endif
-			case ':': kind_ = T_COLON;     blob_ = texts.sym_colon;     return;
-			case ';': kind_ = T_SEMICOLON; blob_ = texts.sym_semicolon; return;
+			case ':': kind_ = T_COLON;     blob_ = texts.sym_colon;     cur_ = i; return;
+			case ';': kind_ = T_SEMICOLON; blob_ = texts.sym_semicolon; cur_ = i; return;
 
 			case '@': {
-				BlobBuilder b;
+				/* Only find the end of the string here.  Unescaping and interning
+				 * is deferred until the value is actually requested. */
+				bool escaped = false;
+				str_begin_ = i;
 				for (;;) {
-					c = read_char();
-					switch (c) {
-						case EOF:
-							throw std::runtime_error("unterminated string");
-
-						case '\n':
-							++line_;
-							col_ = 0;
-							break;
-
-						case '@':
-							c = read_char();
-							if (c != '@') {
-								unget_char(c);
-								blob_ = hash_find(b.get());
-								kind_ = T_STRING;
-								return;
-							}
-							break;
-					}
-					b.add_byte(c);
+					i = find_byte(i, end_, '@');
+					if (i == end_) error("unterminated string");
+
+					if (++i == end_ || *i != '@') break;
+					++i;
+					escaped = true;
 				}
+				str_end_     = i - 1;
+				str_escaped_ = escaped;
+				kind_        = T_STRING;
+				cur_         = i;
+				return;
 			}
 
 			default: {
-				BlobBuilder b;
 				if (is_num_char(c)) {
-					do {
-						b.add_byte(c);
-						c = read_char();
-					} while (is_num_char(c));
-					if (is_visible_char(c))
+					while (i != end_ && is_num_char(*i)) ++i;
+					if (i != end_ && is_visible_char(*i))
 						goto read_ident;
 					kind_ = T_NUM;
 				} else if (is_visible_char(c)) {
 read_ident:
-					do {
-						b.add_byte(c);
-						c = read_char();
-					} while (is_visible_char(c));
+					while (i != end_ && is_visible_char(*i)) ++i;
 					kind_ = T_ID;
 				} else {
-					throw std::runtime_error("invalid char in input");
+					error("invalid char in input");
 				}
-				unget_char(c);
-				blob_ = hash_find(b.get());
+				blob_ = hash_find(tok_, i - tok_);
+				cur_  = i;
 				return;
 			}
 		}
 	}
 }
 
+Blob* Lexer::string_blob() const
+{
+	u1 const* const begin = str_begin_;
+	u1 const* const end   = str_end_;
+	if (!str_escaped_) return Blob::alloc(begin, end - begin);
+
+	Blob* const b = Blob::alloc(end - begin);
+	for (u1 const* i = begin; i != end; ++i) {
+		b->append(*i);
+		if (*i == '@') ++i; // Skip the second '@' of "@@".
+	}
+	return b;
+}
+
+Symbol Lexer::string_symbol() const
+{
+	if (!str_escaped_) return hash_find(str_begin_, str_end_ - str_begin_);
+	return hash_find(string_blob());
+}
+
 Symbol Lexer::add_keyword(char const* const s)
 {
 	return hash_find(Blob::alloc(s));
@@ -148,27 +182,49 @@ Symbol Lexer::add_symbol(Blob* const b)
 	return hash_find(b);
 }
 
+Symbol Lexer::add_symbol(u1 const* const data, size_t const size)
+{
+	return hash_find(data, size);
+}
+
 Symbol Lexer::expect(Symbol const b)
 {
 	if (kind_ == T_ID && blob_ == b) {
 		next();
 		return b;
 	} else {
-		throw std::runtime_error("unexpected token");
+		error("unexpected token");
 	}
 }
 
 Symbol Lexer::expect(TokenKind const t)
 {
 	if (kind_ == t) {
-		Symbol const b = blob_;
+		Symbol const b = t == T_STRING ? string_symbol() : blob_;
 		next();
 		return b;
 	} else {
-		throw std::runtime_error("unexpected token");
+		error("unexpected token");
 	}
 }
 
+void Lexer::skip(TokenKind const t)
+{
+	if (kind_ == t) {
+		next();
+	} else {
+		error("unexpected token");
+	}
+}
+
+Blob* Lexer::expect_text()
+{
+	if (kind_ != T_STRING) error("unexpected token");
+	Blob* const b = string_blob();
+	next();
+	return b;
+}
+
 Symbol Lexer::accept(Symbol const b)
 {
 	if (kind_ == T_ID && blob_ == b) {
@@ -182,7 +238,7 @@ Symbol Lexer::accept(Symbol const b)
 Symbol Lexer::accept(TokenKind const t)
 {
 	if (kind_ == t) {
-		Symbol const b = blob_;
+		Symbol const b = t == T_STRING ? string_symbol() : blob_;
 		next();
 		return b;
 	} else {
@@ -1,7 +1,5 @@
 #ifndef LEXER_H
-#define LEDER_H
-
-#include <stdio.h>
+#define LEXER_H
 
 #include "blob.h"
 #include "types.h"
@@ -22,13 +20,17 @@ enum TokenKind
 	T_STRING,
 };
 
+/* Scans RCS text held in memory, e.g. a MappedFile.  Identifiers and numbers
+ * are looked up in the symbol table directly from the input; a string only
+ * becomes a Symbol, when its value is requested by expect() or accept(). */
 class Lexer
 {
 public:
-	Lexer(FILE*);
+	Lexer(u1 const* begin, u1 const* end);
 
 	static Symbol add_keyword(char const*);
 	static Symbol add_symbol(Blob*);
+	static Symbol add_symbol(u1 const*, size_t);
 
 	void next();
 
@@ -38,20 +40,33 @@ public:
 	Symbol accept(Symbol);
 	Symbol accept(TokenKind);
 
-	u4 line() const { return line_; }
-	u4 col()  const { return col_; }
+	// Like expect(), but a string is neither unescaped nor interned.
+	void skip(TokenKind);
+
+	/* Like expect(T_STRING), but the unescaped value is not interned.  The
+	 * caller owns the returned Blob. */
+	Blob* expect_text();
+
+	// Position of the current token, computed on demand.
+	u4 line() const;
+	u4 col()  const;
 
 private:
-	int read_char();
+	Symbol string_symbol() const;
+
+	Blob* string_blob() const;
 
-	void unget_char(int);
+	void error(char const*) const __attribute__((noreturn));
 
-	FILE*     f_;
-	TokenKind kind_;
-	u4        line_;
-	u4        col_;
-	u4        colstart_;
-	Symbol    blob_;
+	u1 const* const begin_;
+	u1 const* const end_;
+	u1 const*       cur_;
+	u1 const*       tok_;
+	TokenKind       kind_;
+	Symbol          blob_;
+	u1 const*       str_begin_;
+	u1 const*       str_end_;
+	bool            str_escaped_;
 };
 
 #endif
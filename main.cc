@@ -1,24 +1,37 @@
 #include <algorithm>
 #include <cstdio>
 #include <cstdlib>
-#include <iomanip>
+#include <cstring>
 #include <iostream>
+#include <sstream>
 #include <stdexcept>
 #include <string>
 #include <unistd.h>
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <fnmatch.h>
 #include <fts.h>
 
+#include "arena.h"
 #include "blob.h"
+#include "checkpoint.h"
 #include "date.h"
 #include "heap.h"
 #include "indent.h"
 #include "lexer.h"
+#include "mappedfile.h"
+#include "memstats.h"
+#include "mutex.h"
+#include "output.h"
+#include "parsecache.h"
 #include "piecetable.h"
 #include "set.h"
+#include "sha1.h"
+#include "sharedset.h"
 #include "strutil.h"
+#include "text.h"
+#include "trace.h"
 #include "types.h"
 #include "uptr.h"
 #include "vector.h"
@@ -31,7 +44,6 @@
 #endif
 
 using std::cerr;
-using std::cout;
 using std::endl;
 
 enum OutputFormat
@@ -41,6 +53,11 @@ enum OutputFormat
 };
 
 static OutputFormat output_format = OUT_GIT;
+static char const*  trunk_name    = 0;
+static char const*  tags_name     = 0;
+static char const*  email_domain  = 0;
+
+static Output out(STDOUT_FILENO);
 
 namespace Sym
 {
@@ -50,6 +67,7 @@ namespace Sym
 	static Symbol branch;
 	static Symbol branches;
 	static Symbol comment;
+	static Symbol commitid;
 	static Symbol date;
 	static Symbol dead;
 	static Symbol desc;
@@ -74,7 +92,7 @@ namespace Sym
 #undef major
 #undef minor
 
-struct RevNum
+struct RevNum : ArenaObject
 {
 	RevNum(RevNum const* const pre, u4 const major, u4 const minor) :
 		pre(pre),
@@ -86,6 +104,8 @@ struct RevNum
 
 	u4 hash() const { return ((pre ? pre->hash() * 31 : 0) + major * 31) + minor; }
 
+	RevNum* create() const { return new RevNum(pre, major, minor); }
+
 	static RevNum const* parse(Symbol);
 
 	RevNum const* const pre;
@@ -103,7 +123,7 @@ static bool operator <(RevNum const& a, RevNum const& b)
 	return a.pre == b.pre && (a.major < b.major || (a.major == b.major && a.minor < b.minor));
 }
 
-static Set<RevNum*> revnums;
+static SharedSet<RevNum*> revnums;
 
 RevNum const* RevNum::parse(Symbol const s)
 {
@@ -143,7 +163,7 @@ RevNum const* RevNum::parse(Symbol const s)
 		}
 
 done:
-		rev = revnums.insert(new RevNum(rev, major, minor));
+		rev = revnums.find_or_insert(RevNum(rev, major, minor));
 		if (i == end) return rev;
 
 		if (*i++ != '.') goto invalid;
@@ -153,7 +173,7 @@ invalid:
 	throw std::runtime_error("invalid revision number");
 }
 
-static std::ostream& operator <<(std::ostream& o, RevNum const& r)
+template<typename Stream> static Stream& operator <<(Stream& o, RevNum const& r)
 {
 	if (r.pre) {
 		o << *r.pre << '.';
@@ -161,7 +181,7 @@ static std::ostream& operator <<(std::ostream& o, RevNum const& r)
 	return o << r.major << '.' << r.minor;
 }
 
-struct Directory
+struct Directory : ArenaObject
 {
 	Directory() :
 		name(0),
@@ -171,7 +191,7 @@ struct Directory
 	{}
 
 	Directory(char const* const name, Directory* const parent) :
-		name(strdup(name)),
+		name(Arena::current().strdup(name)),
 		parent(parent),
 		depth(parent->depth + 1),
 		id(next_id++)
@@ -190,7 +210,7 @@ private:
 
 size_t Directory::next_id = 0;
 
-static std::ostream& operator <<(std::ostream& o, Directory const& d)
+template<typename Stream> static Stream& operator <<(Stream& o, Directory const& d)
 {
 	if (d.parent) {
 		o << *d.parent;
@@ -210,24 +230,35 @@ static bool operator <(Directory const& a, Directory const& b)
 
 struct FileRev;
 
-struct File
+struct File : ArenaObject
 {
 	File(char const* const name, Directory* const dir, bool const executable) :
-		name(strdup(name)),
+		name(Arena::current().strdup(name)),
 		dir(dir),
 		executable(executable),
-		head()
+		head(),
+		id(next_id++),
+		rank()
 	{}
 
 	u4 hash() const { return (uintptr_t)this >> 4; }
 
+	static size_t n_ids() { return next_id; }
+
 	char*      const name;
 	Directory* const dir;
 	bool       const executable;
 	FileRev*         head;
+	size_t     const id;
+	size_t           rank; // Position in path order, see rank_files()
+
+private:
+	static size_t next_id;
 };
 
-static std::ostream& operator <<(std::ostream& o, File const& f)
+size_t File::next_id = 0;
+
+template<typename Stream> static Stream& operator <<(Stream& o, File const& f)
 {
 	if (f.dir) {
 		o << *f.dir;
@@ -264,11 +295,6 @@ static bool operator <(File const& a, File const& b)
 	}
 }
 
-static bool operator ==(File const& a, File const& b)
-{
-	return &a == &b;
-}
-
 enum State
 {
 	STATE_DEAD,
@@ -289,7 +315,39 @@ static std::ostream& operator <<(std::ostream& o, State const s)
 
 struct Changeset;
 
-struct FileRev
+struct CachedContent;
+
+// ArenaObject, which is counted as kind K in the memory report of -p.
+template<MemKind K> struct CountedObject : ArenaObject
+{
+	static void* operator new(size_t const size)
+	{
+		mem_count(K, size, 1);
+		return ArenaObject::operator new(size);
+	}
+
+	static void operator delete(void* const p, size_t const size)
+	{
+		mem_count(K, -(long long)size, -1);
+		ArenaObject::operator delete(p, size);
+	}
+};
+
+// Appends r to v and counts the growth of v as kind k.
+static void push_counted(Vector<FileRev*>& v, FileRev* const r, MemKind const k)
+{
+	size_t const capacity = v.capacity();
+	v.push_back(r);
+	if (v.capacity() != capacity) mem_count(k, (long long)(v.capacity() - capacity) * sizeof(FileRev*), 0);
+}
+
+// Counts the bytes of a deltatext taken over (or, if negative, released) by a FileRev.
+static inline void count_text(Blob const* const text, long long const sign)
+{
+	if (text) mem_count(MEM_TEXTS, sign * (long long)(sizeof(*text) + text->size), sign);
+}
+
+struct FileRev : CountedObject<MEM_FILEREVS>
 {
 	FileRev(File const* file, RevNum const* const rev) :
 		file(file),
@@ -298,27 +356,40 @@ struct FileRev
 		author(),
 		state(),
 		log(),
+		commitid(),
 		text(),
 		pred(),
 		next(),
+		base(),
 		changeset(),
-		mark()
+		mark(),
+		snapshot(),
+		cached(),
+		converted(),
+		in_base(),
+		too_new()
 	{}
 
 	u4 hash() const { return rev->hash(); }
 
-	File   const* file;
-	RevNum const* rev;
-	Date          date;
-	Symbol        author;
-	State         state;
-	Symbol        log;
-	Symbol        text;
-	FileRev*      pred;
-	FileRev*      next; // The next file revision on the same branch
-	Changeset*    changeset;
-	u4            mark;
-	PieceTable    content;
+	File   const*  file;
+	RevNum const*  rev;
+	Date           date;
+	Symbol         author;
+	State          state;
+	Symbol         log;
+	Symbol         commitid; // Written by CVS 1.12 and later
+	Blob*          text; // Owned; not interned, see release_texts()
+	FileRev*       pred;
+	FileRev*       next; // The next file revision on the same branch
+	FileRev*       base; // The revision this deltatext applies to
+	Changeset*     changeset;
+	u4             mark;
+	PieceTable*    snapshot; // Content kept for svn output, see ContentCache
+	CachedContent* cached;
+	bool           converted; // By an earlier incremental run or before the window, see -I and -a
+	bool           in_base;   // Part of the tree at the start of the window
+	bool           too_new;   // After the window, see -u
 };
 
 static inline bool operator ==(FileRev const& a, FileRev const& b)
@@ -326,58 +397,70 @@ static inline bool operator ==(FileRev const& a, FileRev const& b)
 	return a.file == b.file && a.rev == b.rev;
 }
 
-struct Changeset
+struct Changeset : CountedObject<MEM_CHANGESETS>
 {
-	Changeset(Symbol const log, Symbol const author) :
+	Changeset(Symbol const log, Symbol const author, Symbol const commitid = 0, u4 const bucket = 0) :
 		log(log),
 		author(author),
+		commitid(commitid),
+		bucket(bucket),
 		oldest(9999, 12, 31, 23, 59, 59),
-#if DEBUG_SPLIT
 		newest(0, 1, 1, 0, 0, 0),
-#endif
 		filerevs(),
-		n_succ(),
 		id(),
 		mark()
 	{}
 
-	u4 hash() const { return log->hash() ^ author->hash(); }
+	~Changeset() { mem_count(MEM_CHANGESETS, -(long long)(filerevs.capacity() * sizeof(FileRev*)), 0); }
+
+	u4 hash() const { return log->hash() ^ author->hash() ^ (commitid ? commitid->hash() : 0) ^ bucket; }
 
 	void add(FileRev* const f)
 	{
 		Date const& d = f->date;
 		if (d < oldest)
 			oldest = d;
-#if DEBUG_SPLIT
 		if (newest < d)
 			newest = d;
-#endif
-		filerevs.push_back(f);
+		hold(f);
 		f->changeset = this;
 	}
 
+	// Adds f without touching its change set or the dates.
+	void hold(FileRev* const f) { push_counted(filerevs, f, MEM_CHANGESETS); }
+
+	// Takes over the file revisions of the next bucket.
+	void join(Changeset& c)
+	{
+		for (Vector<FileRev*>::const_iterator i = c.filerevs.begin(), end = c.filerevs.end(); i != end; ++i) {
+			add(*i);
+		}
+		bucket = c.bucket;
+	}
+
 	Symbol           log;
 	Symbol           author;
+	Symbol           commitid; // Groups exactly the revisions of one commit
+	u4               bucket;   // Time slot of the revisions, see bucket_of()
 	Date             oldest;
-#if DEBUG_SPLIT
 	Date             newest;
-#endif
 	Vector<FileRev*> filerevs;
-	size_t           n_succ;
 	size_t           id;
 	u4               mark;
 };
 
 static inline bool operator ==(Changeset const& a, Changeset const& b)
 {
-	return a.log == b.log && a.author == b.author;
+	return a.log == b.log && a.author == b.author && a.commitid == b.commitid && a.bucket == b.bucket;
 }
 
-struct Tag
+struct Tag : CountedObject<MEM_TAGS>
 {
 	Tag(Symbol const name) : name(name), latest() {}
 
-	void add(FileRev* const r) { filerevs.push_back(r); }
+	~Tag() { mem_count(MEM_TAGS, -(long long)(filerevs.capacity() * sizeof(FileRev*)), 0); }
+
+	void add(FileRev* const r) { push_counted(filerevs, r, MEM_TAGS); }
 
 	u4 hash() const { return name->hash(); }
 
@@ -393,74 +476,121 @@ static inline bool operator ==(Tag const& a, Tag const &b)
 
 static Vector<char const*> expand_keywords;
 static bool                verbose         = false;
+static bool                dedup_blobs     = false;
+static bool                save_parsed     = false; // Write a parse cache
+static bool                parse_only      = false; // Write a shard, see -S
 static Set<Changeset*>     changesets;
 static Set<Tag*>           tags;
 static size_t              file_revs;
 static size_t              on_trunk;
 static size_t              n_files;
 static bool                in_attic;
+static u4                  split_threshold = 5 * 60;
+static Date                window_since;                           // See -a
+static Date                window_until(9999, 12, 31, 23, 59, 59); // See -u
+static Changeset*          window_base = 0;                        // The tree at window_since
+static Vector<char const*> include_patterns; // See -i
+static Vector<char const*> exclude_patterns; // See -x
 
 static std::ostream& print_read_status()
 {
 	return cerr << CLEAR << n_files << " files, " << file_revs << " file revisions, " << on_trunk << " on trunk, " << changesets.size() << " changesets, " << tags.size() << " tags";
 }
 
-static void accept_newphrase(Lexer& l, Symbol const stop_at = 0)
+/* Returns true, if stop_at was found.  The value of a commitid is stored, if
+ * it is asked for. */
+static bool accept_newphrase(Lexer& l, std::ostream& diag, Symbol const stop_at = 0, Symbol* const commitid = 0)
 {
 	while (Symbol const sym = l.accept(T_ID)) {
-		if (sym == stop_at) break;
-		cerr << CLEAR "warning: ignoring newphrase '" << *sym << "'\n";
+		if (sym == stop_at) return true;
+		if (sym == Sym::commitid && commitid) {
+			Symbol const id = l.accept(T_ID);
+			*commitid = id ? id : l.expect(T_NUM);
+			l.expect(T_SEMICOLON);
+			continue;
+		}
+		diag << CLEAR "warning: ignoring newphrase '" << *sym << "'\n";
 		while (l.accept(T_ID) || l.accept(T_NUM) || l.accept(T_STRING) || l.accept(T_COLON)) {}
 		l.expect(T_SEMICOLON);
 	}
+	return false;
 }
 
-static Blob* unexpand(Symbol const src)
+struct TagRev
 {
-	BlobBuilder dst;
-	for (u1 const* si = src->begin(), * const send = src->end(); si != send;) {
-		dst.add_byte(*si);
+	TagRev() : name(), rev() {}
 
-		if (*si++ == '$') {
-			u1 const* sk = si;
+	TagRev(Symbol const name, FileRev* const rev) : name(name), rev(rev) {}
 
-			for (;; ++sk) {
-				if (sk == send) goto no_keyword;
-				u1 const c = *sk;
-				if (!between('A', c, 'Z') && !between('a', c, 'z')) break;
-			}
+	Symbol   name;
+	FileRev* rev;
+};
 
-			u1 const* const colon = sk;
-			if (sk == send || *sk++ != ':') goto no_keyword;
+/* A ,v file found by the directory walk.  Parsing and delta reconstruction
+ * only touch the job, its File and the symbol tables, so jobs can be run by
+ * worker threads.  Everything affecting the global changesets and tags is
+ * collected here and registered by the main thread in walk order. */
+struct ParseJob
+{
+	enum JobState
+	{
+		JOB_PENDING,
+		JOB_RUNNING,
+		JOB_DONE
+	};
 
-			do {
-				if (sk == send) goto no_keyword;
-				if (*sk == '\n') goto no_keyword;
-			} while (*sk++ != '$');
-
-			for (Vector<char const*>::const_iterator vi = expand_keywords.begin(), vend = expand_keywords.end(); vi != vend; ++vi) {
-				u1   const* sm = si;
-				char const* k  = *vi;
-				for (; *sm == (u1)*k; ++sm, ++k) {}
-
-				if (*k == '\0' && sm == colon) {
-					while (si != colon) {
-						dst.add_byte((u1)*si++);
-					}
-					dst.add_byte('$');
-					si = sk;
-					break;
-				}
-			}
-		}
-no_keyword:;
-	}
-	return dst.get();
+	ParseJob(char const* const path, File* const file, CacheKey const& key, bool const in_attic) :
+		path(strdup(path)),
+		file(file),
+		size(key.size),
+		key(key),
+		in_attic(in_attic),
+		n_revs(),
+		n_trunk(),
+		cached(),
+		cached_end(),
+		converted_head(),
+		stream(),
+		state(JOB_PENDING)
+	{}
+
+	~ParseJob() { free(path); }
+
+	char*       const  path;
+	File*       const  file;
+	off_t       const  size;
+	CacheKey    const  key;
+	bool        const  in_attic;
+	size_t             n_revs;     // Number of deltas
+	size_t             n_trunk;    // Number of deltas on trunk
+	Vector<FileRev*>   revs;       // Trunk revisions ordered by number
+	Vector<TagRev>     tagged;     // Tags of trunk revisions
+	Vector<FileRev*>   deltatexts; // Trunk revisions in order of their deltatexts
+	u1 const*          cached;     // Record in the parse cache, if up to date
+	u1 const*          cached_end;
+	std::string        record;     // New parse cache record
+	RevNum const*      converted_head; // By an earlier incremental run
+	std::ostringstream diag;       // Diagnostics, when run by a worker
+	std::string        error;      // Error, when run by a worker
+	std::string        blobs;      // Git blob contents, when run by a worker
+	Vector<size_t>     blob_sizes;
+	Vector<Digest>     blob_digests; // With -D
+	bool               stream;     // Blobs too large to buffer, the main thread writes them
+	JobState           state;
+	Span               parse;
+	Span               reconstruct;
+};
+
+static bool rev_less(FileRev const* const a, FileRev const* const b)
+{
+	return *a->rev < *b->rev;
 }
 
-static void read_file(FILE* const f, File* const file)
+static void read_file(MappedFile const& f, ParseJob& job, std::ostream& diag)
 {
-	Lexer l(f);
+	File* const file = job.file;
+
+	Lexer l(f.begin(), f.end());
 
 	Set<FileRev*> revs;
 
@@ -516,8 +646,7 @@ static void read_file(FILE* const f, File* const file)
 		RevNum const* const rev = RevNum::parse(srev);
 		if (rev->trunk()) {
 			FileRev* const filerev = revs.insert(new FileRev(file, rev));
-			Tag*     const tag     = tags.insert(new Tag(ssym));
-			tag->add(filerev);
+			job.tagged.push_back(TagRev(ssym, filerev));
 		}
 	}
 	l.expect(T_SEMICOLON);
@@ -543,13 +672,14 @@ static void read_file(FILE* const f, File* const file)
 		if (expand == Sym::b || expand == Sym::o) {
 			binary = true;
 		} else if (expand && expand != Sym::k && expand != Sym::k && expand != Sym::kv && expand != Sym::kvl && expand != Sym::v) {
-			cerr << CLEAR "error: invalid substitution mode '" << *expand << "' in " << *file << "; ignoring\n";
+			diag << CLEAR "error: invalid substitution mode '" << *expand << "' in " << *file << "; ignoring\n";
 		}
 		l.expect(T_SEMICOLON);
 	}
 
-	accept_newphrase(l);
+	accept_newphrase(l, diag);
 
+	bool at_desc = false;
 	while (Symbol const srev = l.accept(T_NUM)) {
 		l.expect(Sym::date);
 		Symbol const sdate = l.expect(T_NUM);
@@ -572,32 +702,35 @@ static void read_file(FILE* const f, File* const file)
 		Symbol const snext = l.accept(T_NUM);
 		l.expect(T_SEMICOLON);
 
-		if (++file_revs % 100 == 0 && !verbose) {
-			print_read_status() << ' ' << *file;
-		}
+		// The desc after the last delta cannot be told apart from a newphrase.
+		Symbol commitid = 0;
+		at_desc = accept_newphrase(l, diag, Sym::desc, &commitid);
+
+		++job.n_revs;
 
 		RevNum const* const rev = RevNum::parse(srev);
 		if (rev->trunk()) {
-			++on_trunk;
+			++job.n_trunk;
 			FileRev* const filerev = revs.insert(new FileRev(file, rev));
 			if (snext) {
 				RevNum  const* const pred = RevNum::parse(snext);
 				FileRev*       const prev = revs.insert(new FileRev(file, pred));
 
 				if (prev->next) {
-					cerr << CLEAR "warning: both " << *prev->next->rev << " and " << *rev << " of " << *file << " have " << *pred << " as predecessor\n";
+					diag << CLEAR "warning: both " << *prev->next->rev << " and " << *rev << " of " << *file << " have " << *pred << " as predecessor\n";
 				}
 
 				filerev->pred = prev;
 				prev->next    = filerev;
 			}
-			filerev->date   = date;
-			filerev->author = sauthor;
+			filerev->date     = date;
+			filerev->author   = sauthor;
+			filerev->commitid = commitid;
 			if (sstate == Sym::dead) {
 				filerev->state = STATE_DEAD;
 			} else {
 				if (sstate != Sym::Exp) {
-					cerr << CLEAR "warning: " << *file << ' ' << *rev << " has unknown state '" << *sstate << "'; treating as 'Exp'\n";
+					diag << CLEAR "warning: " << *file << ' ' << *rev << " has unknown state '" << *sstate << "'; treating as 'Exp'\n";
 				}
 				filerev->state = STATE_EXP;
 			}
@@ -606,321 +739,2298 @@ static void read_file(FILE* const f, File* const file)
 
 	if (FileRev* next = file->head->next) {
 		while (next->next) next = next->next;
-		cerr << CLEAR "warning: head of " << *file << " is " << *file->head->rev << " but latest revision is " << *next->rev << "; using the latter as head\n";
+		diag << CLEAR "warning: head of " << *file << " is " << *file->head->rev << " but latest revision is " << *next->rev << "; using the latter as head\n";
 		file->head = next;
 	}
 
 	if (!file->head->author) {
-		cerr << CLEAR "error: head of " << *file << " does not exist\n";
-	} else if (in_attic && file->head->state != STATE_DEAD) {
-		cerr << CLEAR "warning: " << *file << " is in " ATTIC ", but head is not dead; treating as dead\n";
+		diag << CLEAR "error: head of " << *file << " does not exist\n";
+	} else if (job.in_attic && file->head->state != STATE_DEAD) {
+		diag << CLEAR "warning: " << *file << " is in " ATTIC ", but head is not dead; treating as dead\n";
 		file->head->state = STATE_DEAD;
-	} else if (!in_attic && file->head->state == STATE_DEAD) {
-		cerr << CLEAR "warning: " << *file << " is not in " ATTIC ", but head is dead\n";
+	} else if (!job.in_attic && file->head->state == STATE_DEAD) {
+		diag << CLEAR "warning: " << *file << " is not in " ATTIC ", but head is dead\n";
 	}
 
-	accept_newphrase(l, Sym::desc);
-	l.expect(T_STRING);
+	if (!at_desc) accept_newphrase(l, diag, Sym::desc);
+	l.skip(T_STRING);
 
 	while (Symbol const srev = l.accept(T_NUM)) {
+		RevNum const* const rev = RevNum::parse(srev);
+
 		l.expect(Sym::log);
+		if (!rev->trunk()) {
+			// Branches are not converted, so do not keep their log and text.
+			l.skip(T_STRING);
+			accept_newphrase(l, diag, Sym::text);
+			l.skip(T_STRING);
+			continue;
+		}
 		Symbol const slog = l.expect(T_STRING);
 
-		accept_newphrase(l, Sym::text);
-		Symbol stext = l.expect(T_STRING);
-		if (!binary) stext = l.add_symbol(unexpand(stext));
-
-		RevNum const* const rev = RevNum::parse(srev);
-		if (rev->trunk()) {
-			FileRev* const filerev = revs.insert(new FileRev(file, rev));
-			filerev->log  = slog;
-			filerev->text = stext;
-
-			Changeset* const changeset = changesets.insert(new Changeset(slog, filerev->author));
-			changeset->add(filerev);
+		accept_newphrase(l, diag, Sym::text);
+		Blob* text = l.expect_text();
+		if (!binary) {
+			Blob* const raw = text;
+			text = unexpand(raw, expand_keywords);
+			delete raw;
 		}
+
+		FileRev* const filerev = revs.insert(new FileRev(file, rev));
+		filerev->log  = slog;
+		filerev->text = text;
+		count_text(text, 1);
+		job.deltatexts.push_back(filerev);
 	}
 
 	for (FileRev* i = file->head; i; i = i->pred) {
 		if (!i->text) {
-			cerr << CLEAR "error: " << *file << ' ' << *i->rev << " has no deltatext\n";
+			diag << CLEAR "error: " << *file << ' ' << *i->rev << " has no deltatext\n";
 		}
 		if (i->pred && i->date < i->pred->date) {
-			cerr << CLEAR "warning: timestamp of " << *file << ' ' << *i->rev << " (" << i->date << ") is older than timestamp of " << *i->pred->rev << " (" << i->pred->date << ")\n";
+			diag << CLEAR "warning: timestamp of " << *file << ' ' << *i->rev << " (" << i->date << ") is older than timestamp of " << *i->pred->rev << " (" << i->pred->date << ")\n";
 		}
 	}
 
 	l.expect(T_EOF);
+
+	for (Set<FileRev*>::iterator i = revs.begin(), end = revs.end(); i != end; ++i) {
+		job.revs.push_back(*i);
+	}
+	std::sort(job.revs.begin(), job.revs.end(), rev_less);
 }
 
-#ifdef __APPLE__
-typedef FTSENT const**       FTSENT_cmp;
-#else
-typedef FTSENT const* const* FTSENT_cmp;
-#endif
+static u4 rev_index(ParseJob const& job, FileRev* const r)
+{
+	if (!r) return RecordWriter::NONE;
+	return std::lower_bound(job.revs.begin(), job.revs.end(), r, rev_less) - job.revs.begin();
+}
 
-static int compar(FTSENT_cmp const a, FTSENT_cmp const b)
+/* Store everything read_file() found out about a file, so a later run can
+ * skip parsing it, if it did not change. */
+static void save_file(ParseJob const& job, RecordWriter& w)
 {
-	return
-		streq((*a)->fts_name, ATTIC) ? -1 :
-		streq((*b)->fts_name, ATTIC) ?  1 :
-		strcmp((*a)->fts_name, (*b)->fts_name);
+	std::string const diag = job.diag.str();
+	w.put_bytes(reinterpret_cast<u1 const*>(diag.data()), diag.size());
+	w.put<u4>(job.n_revs);
+	w.put<u4>(job.n_trunk);
+
+	w.put<u4>(job.revs.size());
+	for (Vector<FileRev*>::const_iterator i = job.revs.begin(), end = job.revs.end(); i != end; ++i) {
+		FileRev const& r = **i;
+		w.put<u4>(r.rev->major);
+		w.put<u4>(r.rev->minor);
+		w.put<u2>(r.date.year);
+		w.put<u1>(r.date.month);
+		w.put<u1>(r.date.day);
+		w.put<u1>(r.date.hour);
+		w.put<u1>(r.date.minute);
+		w.put<u1>(r.date.second);
+		w.put_blob(r.author);
+		w.put<u1>(r.state);
+		w.put_blob(r.log);
+		w.put_blob(r.commitid);
+		w.put_blob(r.text);
+		w.put<u4>(rev_index(job, r.pred));
+		w.put<u4>(rev_index(job, r.next));
+	}
+	w.put<u4>(rev_index(job, job.file->head));
+
+	w.put<u4>(job.tagged.size());
+	for (Vector<TagRev>::const_iterator i = job.tagged.begin(), end = job.tagged.end(); i != end; ++i) {
+		w.put_blob(i->name);
+		w.put<u4>(rev_index(job, i->rev));
+	}
+
+	w.put<u4>(job.deltatexts.size());
+	for (Vector<FileRev*>::const_iterator i = job.deltatexts.begin(), end = job.deltatexts.end(); i != end; ++i) {
+		w.put<u4>(rev_index(job, *i));
+	}
 }
 
-static bool older_changeset(Changeset const* const a, Changeset const* const b)
+static Symbol load_symbol(RecordReader& r)
 {
-	if (a->oldest == b->oldest) {
-		File const& fa = *a->filerevs.front()->file;
-		File const& fb = *b->filerevs.front()->file;
-		return fa < fb;
+	size_t          size;
+	u1 const* const data = r.get_bytes(size);
+	return data ? Lexer::add_symbol(data, size) : 0;
+}
+
+static Blob* load_text(RecordReader& r)
+{
+	size_t          size;
+	u1 const* const data = r.get_bytes(size);
+	return data ? Blob::alloc(data, size) : 0;
+}
+
+static FileRev* rev_at(ParseJob const& job, u4 const i)
+{
+	if (i == RecordWriter::NONE) return 0;
+	if (i >= job.revs.size()) throw std::runtime_error("corrupt parse cache record");
+	return job.revs[i];
+}
+
+// The counterpart of save_file().
+static void load_file(RecordReader& r, ParseJob& job)
+{
+	File* const file = job.file;
+
+	size_t          diag_size;
+	u1 const* const diag = r.get_bytes(diag_size);
+	if (diag) job.diag.write(reinterpret_cast<char const*>(diag), diag_size);
+	job.n_revs  = r.get<u4>();
+	job.n_trunk = r.get<u4>();
+
+	// Links may point forward, so they are resolved once all revisions exist.
+	u4 const   n_revs = r.get<u4>();
+	Vector<u4> links;
+	for (u4 i = 0; i != n_revs; ++i) {
+		u4       const major = r.get<u4>();
+		u4       const minor = r.get<u4>();
+		FileRev* const f     = new FileRev(file, revnums.find_or_insert(RevNum(0, major, minor)));
+		f->date.year   = r.get<u2>();
+		f->date.month  = r.get<u1>();
+		f->date.day    = r.get<u1>();
+		f->date.hour   = r.get<u1>();
+		f->date.minute = r.get<u1>();
+		f->date.second = r.get<u1>();
+		f->author      = load_symbol(r);
+		f->state       = r.get<u1>() == STATE_DEAD ? STATE_DEAD : STATE_EXP;
+		f->log         = load_symbol(r);
+		f->commitid    = load_symbol(r);
+		f->text        = load_text(r);
+		count_text(f->text, 1);
+		links.push_back(r.get<u4>());
+		links.push_back(r.get<u4>());
+		job.revs.push_back(f);
+	}
+	for (u4 i = 0; i != n_revs; ++i) {
+		job.revs[i]->pred = rev_at(job, links[2 * i]);
+		job.revs[i]->next = rev_at(job, links[2 * i + 1]);
 	}
+	file->head = rev_at(job, r.get<u4>());
 
-	return a->oldest < b->oldest;
+	for (u4 n = r.get<u4>(); n != 0; --n) {
+		Symbol const name = load_symbol(r);
+		job.tagged.push_back(TagRev(name, rev_at(job, r.get<u4>())));
+	}
+
+	for (u4 n = r.get<u4>(); n != 0; --n) {
+		job.deltatexts.push_back(rev_at(job, r.get<u4>()));
+	}
+
+	if (!r.done() || !file->head) throw std::runtime_error("corrupt parse cache record");
 }
 
-static bool older_filerev(FileRev const* const a, FileRev const* const b)
+// Parse the file or load the result from the parse cache.
+static void parse_job(ParseJob& job)
 {
-	if (a->file == b->file) {
-		return *a->rev < *b->rev;
-	} else if (a->date == b->date) {
-		return *a->file < *b->file;
+	if (job.cached) {
+		RecordReader r(job.cached, job.cached_end);
+		load_file(r, job);
+
 	} else {
-		return a->date < b->date;
+		MappedFile const f(job.path);
+		read_file(f, job, job.diag);
+		if (save_parsed) {
+			RecordWriter w;
+			save_file(job, w);
+			job.record.swap(w.data());
+		}
+	}
+
+	if (RevNum const* const h = job.converted_head) {
+		for (Vector<FileRev*>::const_iterator i = job.revs.begin(), end = job.revs.end(); i != end; ++i) {
+			FileRev* const r = *i;
+			r->converted = !(*h < *r->rev);
+		}
+	}
+
+	/* The revisions before the window are treated like converted ones.  The
+	 * newest of them makes up the base tree.  The history of the file ends
+	 * before the first revision after the window. */
+	Vector<FileRev*> const& revs = job.revs;
+	size_t                  i    = 0;
+	for (size_t k = 0; k != revs.size(); ++k) {
+		if (revs[k]->date < window_since) i = k + 1;
 	}
+	if (i != 0) revs[i - 1]->in_base = true;
+	for (size_t k = 0; k != i; ++k) revs[k]->converted = true;
+	while (i != revs.size() && revs[i]->date < window_until) ++i;
+	if (i != revs.size() && revs[i]->pred) revs[i]->pred->next = 0;
+	for (; i != revs.size(); ++i) revs[i]->too_new = true;
 }
 
-static char const* check_trunk_name(char const* const name)
+static void write_state(CacheWriter* const state, ParseJob const& job)
 {
-	switch (*name) {
-		case '\0': throw std::runtime_error("trunk name must not be empty");
-		case '/':  throw std::runtime_error("trunk name must not start with a slash ('/')");
-		case '-':  throw std::runtime_error("trunk name must not start with a minus ('-')");
-		default:   break;
+	if (!state) return;
+
+	RecordWriter        w;
+	RevNum const* const head = job.file->head->rev;
+	w.put<u4>(head->major);
+	w.put<u4>(head->minor);
+	std::ostringstream path;
+	static_cast<std::ostream&>(path) << *job.file;
+	state->add(path.str().c_str(), job.key, w.data().data(), w.data().size());
+}
+
+// Returns the number of bytes released.
+static size_t write_record(CacheWriter* const cache, ParseJob& job)
+{
+	if (!cache) return 0;
+
+	if (job.cached) {
+		cache->add(job.path, job.key, job.cached, job.cached_end - job.cached);
+		return 0;
 	}
 
-	for (char const* i = name; *i != '\0'; ++i) {
-		if (*i == '/') {
-			switch (i[1]) {
-				case '\0': throw std::runtime_error("trunk name must not end with a slash ('/')");
-				case '/':  throw std::runtime_error("trunk name must not contain consecutive slashes ('//')");
-			}
-		} else if (!between('A', *i, 'Z') && !between('a', *i, 'z') && !between('0', *i, '9') && *i != '_' && *i != '+' && *i != '-' && *i != '.') {
-			throw std::runtime_error("trunk name may only contain letters, digits, underscore, plus, minus and period");
+	size_t const size = job.record.size();
+	cache->add(job.path, job.key, job.record.data(), size);
+	std::string().swap(job.record);
+	return size;
+}
+
+/* Revisions without commitid are only grouped within a time slot, which is
+ * longer than the split threshold.  So a common log message does not collect
+ * into one giant change set, which has to be split again.  Change sets of
+ * neighbouring slots are joined later, if the split would not separate them;
+ * see join_buckets(). */
+static u4 bucket_of(FileRev const& r)
+{
+	/* 64 bit, so the maximal threshold does not wrap the slot width to 0. */
+	return r.commitid ? 0 : r.date.seconds() / (split_threshold + (u8)1);
+}
+
+/* Make the results of a parsed file visible to the changeset and tag
+ * construction.  This must happen in walk order, so the result does not
+ * depend on the order in which the files were parsed. */
+static void register_file(ParseJob& job)
+{
+	size_t const old_revs = file_revs;
+	++n_files;
+	file_revs += job.n_revs;
+	on_trunk  += job.n_trunk;
+
+	for (Vector<TagRev>::const_iterator i = job.tagged.begin(), end = job.tagged.end(); i != end; ++i) {
+		Tag* const tag = tags.insert(new Tag(i->name));
+		tag->add(i->rev);
+	}
+
+	for (Vector<FileRev*>::const_iterator i = job.deltatexts.begin(), end = job.deltatexts.end(); i != end; ++i) {
+		FileRev* const filerev = *i;
+		if (filerev->too_new) continue;
+		if (filerev->in_base) {
+			// Not added, the base tree has the date of the window start.
+			filerev->changeset = window_base;
+			if (filerev->state != STATE_DEAD) window_base->hold(filerev);
+			continue;
 		}
+		if (filerev->converted) continue;
+		Changeset* const changeset = changesets.insert(new Changeset(filerev->log, filerev->author, filerev->commitid, bucket_of(*filerev)));
+		changeset->add(filerev);
 	}
 
-	return name;
+	if (file_revs / 100 != old_revs / 100 && !verbose) {
+		print_read_status() << ' ' << *job.file;
+	}
 }
 
-static bool is_executable(FILE* const f)
+static size_t const snapshot_interval = 16;
+
+/* Keep the content of every snapshot_interval-th trunk revision of a file,
+ * starting at the head, for svn output.  The content of the other revisions
+ * is rebuilt from these by ContentCache, when it is needed. */
+static void take_snapshots(File* const f)
 {
-	struct stat stat_buf;
-	if (fstat(fileno(f), &stat_buf) != 0) {
-		std::runtime_error("fstat failed");
+	FileRev*   r = f->head;
+	PieceTable p(*r->text);
+	for (size_t n = 0;; ++n) {
+		if (n % snapshot_interval == 0) {
+			r->snapshot = new PieceTable();
+			r->snapshot->swap(p);
+		}
+		FileRev* const pred = r->pred;
+		if (!pred) break;
+		pred->base = r;
+		p.modify(r->snapshot ? *r->snapshot : p, *pred->text);
+		r = pred;
 	}
-	return stat_buf.st_mode & (S_IXUSR | S_IXGRP | S_IXOTH);
 }
 
-static size_t log2(size_t const v)
+struct CachedContent
 {
-	return
-		v <         10 ? 1 :
-		v <        100 ? 2 :
-		v <       1000 ? 3 :
-		v <      10000 ? 4 :
-		v <     100000 ? 5 :
-		v <    1000000 ? 6 :
-		v <   10000000 ? 7 :
-		v <  100000000 ? 8 :
-		v < 1000000000 ? 9 :
-		10;
-}
+	CachedContent(FileRev* const rev) : rev(rev), prev(), next() {}
 
-static void add_dir_entry(char const* const prefix, Vector<size_t>& n_entries, Directory* const d)
+	FileRev*       rev;
+	PieceTable     content;
+	CachedContent* prev;
+	CachedContent* next;
+};
+
+/* Content of file revisions for svn output.  A revision is rebuilt by
+ * applying the deltas from the nearest newer revision, which is cached or has
+ * a snapshot.  The revisions passed on the way are cached, too, since they are
+ * the ones emitted next.  The least recently used entries are dropped, when
+ * the pieces exceed the budget. */
+class ContentCache
 {
-	if (d && n_entries[d->id]++ == 0) {
-		add_dir_entry(prefix, n_entries, d->parent);
-		cout << "Node-path: " << prefix << '/' << *d << "\nNode-kind: dir\nNode-action: add\n\n";
+public:
+	ContentCache(size_t const budget) : budget_(budget), used_(0), first_(), last_() {}
+
+	~ContentCache();
+
+	PieceTable const& get(FileRev*);
+
+private:
+	void link(CachedContent*);
+
+	void unlink(CachedContent*);
+
+	void evict();
+
+	size_t         budget_;
+	size_t         used_;
+	CachedContent* first_; // Most recently used
+	CachedContent* last_;
+
+	ContentCache(ContentCache const&);    // No copy
+	void operator =(ContentCache const&); // No assignment
+};
+
+ContentCache::~ContentCache()
+{
+	while (CachedContent* const c = first_) {
+		unlink(c);
+		delete c;
 	}
 }
 
-static void del_dir_entry(char const* const prefix, Vector<size_t>& n_entries, Directory* const d)
+void ContentCache::link(CachedContent* const c)
 {
-	if (d && --n_entries[d->id] == 0) {
-		cout << "Node-path: " << prefix << '/' << *d << "\nNode-kind: dir\nNode-action: delete\n\n";
-		del_dir_entry(prefix, n_entries, d->parent);
+	c->prev = 0;
+	c->next = first_;
+	if (first_) {
+		first_->prev = c;
+	} else {
+		last_ = c;
 	}
+	first_ = c;
 }
 
-static bool older_tag(Tag const* const a, Tag const* const b)
+void ContentCache::unlink(CachedContent* const c)
 {
-	return b->latest->id < a->latest->id;
+	(c->prev ? c->prev->next : first_) = c->next;
+	(c->next ? c->next->prev : last_)  = c->prev;
 }
 
-static bool tagged_rev_older(FileRev const* const a, FileRev const* const b)
+void ContentCache::evict()
 {
-	return b->changeset->id < a->changeset->id;
+	// The most recently used entry is always kept, it is still referenced.
+	while (used_ > budget_ && last_ != first_) {
+		CachedContent* const c = last_;
+		unlink(c);
+		used_ -= c->content.footprint();
+		c->rev->cached = 0;
+		delete c;
+	}
 }
 
-static bool is_cont_byte(u1 const c)
+PieceTable const& ContentCache::get(FileRev* const r)
 {
-	return 0x80 <= c && c < 0xC0;
+	Vector<FileRev*> path;
+	FileRev*         b = r;
+	for (; !b->cached && !b->snapshot; b = b->base) {
+		path.push_back(b);
+	}
+
+	PieceTable const* p = b->snapshot;
+	if (CachedContent* const c = b->cached) {
+		unlink(c);
+		link(c);
+		p = &c->content;
+	}
+
+	for (size_t i = path.size(); i-- != 0;) {
+		FileRev*       const x = path[i];
+		CachedContent* const c = new CachedContent(x);
+		c->content.modify(*p, *x->text);
+		used_    += c->content.footprint();
+		x->cached = c;
+		link(c);
+		p = &c->content;
+	}
+
+	evict();
+	return *p;
 }
 
-static Blob* convert_log(Blob const& src)
+/* Pass the content of every live trunk revision of a file to the sink for
+ * git output, newest first, until the sink returns false.  Only one piece
+ * table is kept at a time.  The revisions from the first converted one on
+ * were written by an earlier run or are older than the base tree of the
+ * window. */
+template<typename Sink> static void reconstruct_blobs(File* const f, Sink& sink)
 {
-	BlobBuilder     b;
-	u1 const*       i      = src.begin();
-	u1 const* const end    = src.end();
-	u1 const*       lstart = i;
-	u1 const*       lend   = i;
-	bool            empty  = false;
+	FileRev*   r = f->head;
+	PieceTable p(*r->text);
 	for (;;) {
-		if (i == end) goto end;
-		switch (*i++) {
-			case '\t':
-			case ' ':
-				break;
-
-			case '\r':
-				if (i != end && *i == '\n') ++i;
-				/* FALLTHROUGH */
-			case '\n':
-				// TODO support other encodings besides utf-8/l1 hybrid
-end:
-				if (lstart == lend) {
-					empty = true;
-				} else {
-					if (empty) {
-						empty = false;
-						if (!b.empty()) b.add_byte('\n');
-					}
-					for (u1 const* k = lstart; k != lend;) {
-						u1 const c = *k;
-						if (c < 0x80) {
-							b.add_byte(c);
-							k += 1;
-						} else if (c < 0xC2) {
-							goto convert_byte;
-						} else if (c < 0xE0) {
-							if (lend - k < 2)        goto convert_byte;
-							if (!is_cont_byte(k[1])) goto convert_byte;
-							b.add_byte(c);
-							b.add_byte(k[1]);
-							k += 2;
-						} else if (c < 0xF0) {
-							if (lend - k < 3)        goto convert_byte;
-							if (!is_cont_byte(k[1])) goto convert_byte;
-							if (!is_cont_byte(k[2])) goto convert_byte;
-							b.add_byte(c);
-							b.add_byte(k[1]);
-							b.add_byte(k[2]);
-							k += 3;
-						} else if (c < 0xF1) {
-							if (lend - k < 4)        goto convert_byte;
-							if (!is_cont_byte(k[1])) goto convert_byte;
-							if (!is_cont_byte(k[2])) goto convert_byte;
-							if (!is_cont_byte(k[3])) goto convert_byte;
-							b.add_byte(c);
-							b.add_byte(k[1]);
-							b.add_byte(k[2]);
-							b.add_byte(k[3]);
-							k += 4;
-						} else {
-convert_byte:
-							b.add_byte(0xC0 | c >> 6);
-							b.add_byte(0x80 | (c & 0x3F));
-							k += 1;
-						}
-					}
-					b.add_byte('\n');
-				}
-				if (i == end) return b.get();
-				lstart = lend = i;
-				break;
+		if (r->converted && !r->in_base) break;
+		if (r->state != STATE_DEAD && !r->too_new && !sink(r, p)) break;
+		if (!(r = r->pred)) break;
+		p.modify(p, *r->text);
+	}
+}
 
-			default:
-				lend = i;
-				break;
-		}
+/* The deltatexts of a file are not needed anymore, once its blobs have been
+ * produced.  Only the metadata survives into the changeset phase. */
+static void release_texts(ParseJob& job)
+{
+	for (Vector<FileRev*>::const_iterator i = job.deltatexts.begin(), end = job.deltatexts.end(); i != end; ++i) {
+		FileRev* const r = *i;
+		count_text(r->text, -1);
+		delete r->text;
+		r->text = 0;
 	}
 }
 
-static void emit_svn_revision(size_t const revno, Date const& date, u1 const* const author, size_t const author_len, u1 const* const log, size_t const log_len)
+static Digest digest(PieceTable const& p)
 {
-	size_t const prop_len =
-		(author ? 5 + 11 + 2 + log2(author_len) + 1 + author_len + 1 : 0) + // svn:author
-		4 +  9 + 5 + 28 +                                                   // svn:date
-		4 +  7 + 2 + log2(log_len) + 1 + log_len + 1 +                      // svn:log
-		11;                                                                 // PROPS-END
-	cout <<
-		"Revision-number: " << revno << "\n"
-		"Prop-content-length: " << prop_len << "\n"
-		"Content-length: " << prop_len << "\n"
-		"\n";
-	if (author) {
-		cout << "K 10\nsvn:author\nV "  << author_len << '\n';
-		cout.write(reinterpret_cast<char const*>(author), author_len);
-		cout << '\n';
-	}
-	using std::setw;
-	cout <<
-		"K 8\nsvn:date\nV 27\n" << std::setfill('0')
-		<< setw(4) << (u4)date.year   << '-'
-		<< setw(2) << (u4)date.month  << '-'
-		<< setw(2) << (u4)date.day    << 'T'
-		<< setw(2) << (u4)date.hour   << ':'
-		<< setw(2) << (u4)date.minute << ':'
-		<< setw(2) << (u4)date.second << ".000000Z\n"
-		"K 7\n"
-		"svn:log\n"
-		"V " << log_len << '\n';
-	cout.write(reinterpret_cast<char const*>(log), log_len);
-	cout <<
-		"\n"
-		"PROPS-END\n"
-		"\n";
+	Sha1 s;
+	p.write_to(s);
+	return s.digest();
 }
 
-int main(int argc, char** argv)
-try
+struct BlobDigest : ArenaObject
 {
-	char const* email_domain     = 0;
-	u4          split_threshold  = 5 * 60;
-	char const* tags_name        = 0;
-	char const* trunk_name       = 0;
-	bool        unexpand_default = true;
-	for (;;) {
-		switch (getopt(argc, argv, "KT:e:f:k:s:t:v")) {
-			case -1: goto done_opt;
+	BlobDigest(Digest const& digest, u4 const mark) : digest(digest), mark(mark) {}
 
-			case 'K': unexpand_default = false; break;
+	u4 hash() const { return digest.hash(); }
 
-			case 'T': trunk_name = check_trunk_name(optarg); break;
+	Digest const digest;
+	u4     const mark;
+};
 
-			case 'e': email_domain = optarg; break;
+static inline bool operator ==(BlobDigest const& a, Digest const& b)
+{
+	return a.digest == b;
+}
 
-			case 'f':
-				if (streq(optarg, "git")) {
-					output_format = OUT_GIT;
-				} else if (streq(optarg, "svn")) {
-					output_format = OUT_SVN;
-				} else {
-					cerr << "error: unknown output format '" << optarg << "'\n";
-					return EXIT_FAILURE;
-				}
-				break;
+static inline bool operator ==(BlobDigest const& a, BlobDigest const& b)
+{
+	return a.digest == b.digest;
+}
 
-			case 'k':
-				expand_keywords.push_back(optarg);
-				break;
+// Blobs written so far by their content, for -D.
+static Set<BlobDigest*> blob_digests;
 
-			case 's': {
-				char* end;
-				split_threshold = strtol(optarg, &end, 10);
-				if (optarg == end) {
-					cerr << "error: split threshold '" << optarg << "' is not a number\n";
-					return EXIT_FAILURE;
+/* Returns false, if a blob with the same content has already been written.
+ * The file revision then refers to that blob and no data must follow. */
+static bool write_blob_header(FileRev* const r, u4& mark, size_t const size, Digest const* const digest)
+{
+	if (digest) {
+		if (BlobDigest* const* const b = blob_digests.find_key(*digest)) {
+			r->mark = (*b)->mark;
+			return false;
+		}
+		blob_digests.insert(new BlobDigest(*digest, mark + 1));
+	}
+
+	r->mark = ++mark;
+#ifdef DEBUG_EXPORT
+	out << "# " << *r->file << ' ' << *r->rev << '\n';
+#endif
+	out << "blob\n";
+	out << "mark :" << mark << '\n';
+	out << "data " << size << '\n';
+	return true;
+}
+
+struct WriteBlob
+{
+	WriteBlob(u4& mark) : mark(mark) {}
+
+	bool operator ()(FileRev* const r, PieceTable const& p)
+	{
+		Digest const d = dedup_blobs ? digest(p) : Digest();
+		if (write_blob_header(r, mark, p.size(), dedup_blobs ? &d : 0)) {
+			out << p << '\n';
+		}
+		return true;
+	}
+
+	u4& mark;
+};
+
+/* Keep the blobs of a file parsed by a worker until it is its turn.  The
+ * blobs of a file exceeding max_buffered are dropped again and the main
+ * thread streams them instead, so a file with many large revisions is not
+ * held in memory as a whole. */
+struct BufferBlob
+{
+	static size_t const max_buffered = 16 << 20; // Per file
+
+	BufferBlob(ParseJob& job) : job(job) {}
+
+	bool operator ()(FileRev*, PieceTable const& p)
+	{
+		if (job.blobs.size() + p.size() > max_buffered) {
+			job.stream = true;
+			std::string().swap(job.blobs);
+			Vector<size_t> sizes;
+			std::swap(job.blob_sizes, sizes);
+			Vector<Digest> digests;
+			std::swap(job.blob_digests, digests);
+			return false;
+		}
+		p.write_to(*this);
+		job.blob_sizes.push_back(p.size());
+		if (dedup_blobs) job.blob_digests.push_back(digest(p));
+		return true;
+	}
+
+	void write(u1 const* const data, size_t const size)
+	{
+		job.blobs.append(reinterpret_cast<char const*>(data), size);
+	}
+
+	ParseJob& job;
+};
+
+// Returns the number of bytes released.
+static size_t write_buffered_blobs(ParseJob& job, u4& mark)
+{
+	size_t const      bytes = job.blobs.size();
+	char const*       p     = job.blobs.data();
+
+	Vector<size_t>::const_iterator n = job.blob_sizes.begin();
+	Vector<Digest>::const_iterator d = job.blob_digests.begin();
+	for (FileRev* r = job.file->head; r && (!r->converted || r->in_base); r = r->pred) {
+		if (r->state == STATE_DEAD || r->too_new) continue;
+		size_t const size = *n++;
+		if (write_blob_header(r, mark, size, dedup_blobs ? d++ : 0)) {
+			out.write(p, size);
+			out << '\n';
+		}
+		p += size;
+	}
+	std::string().swap(job.blobs);
+
+	return bytes;
+}
+
+/* Runs parse jobs on worker threads.  Jobs are handed out largest first, so
+ * a few huge files do not keep a single core busy at the end.  The main
+ * thread consumes the jobs in walk order; a job no worker has started yet is
+ * taken over by the main thread instead of waiting for it.  Workers pause
+ * while too much git blob content or parse cache records wait to be
+ * written. */
+class ParseQueue
+{
+public:
+	ParseQueue(Vector<ParseJob*> const& jobs, size_t n_workers);
+
+	~ParseQueue();
+
+	// Claims the job for the calling thread, unless a worker already has it.
+	bool steal(ParseJob&);
+
+	void wait(ParseJob&);
+
+	void release(size_t bytes);
+
+private:
+	static void* worker(void*);
+
+	static bool larger(ParseJob const* const a, ParseJob const* const b) { return a->size > b->size; }
+
+	ParseJob* claim();
+
+	void run();
+
+	static size_t const buffer_budget = 64 << 20; // Per worker
+
+	Vector<ParseJob*>  order_;
+	size_t             next_;
+	size_t             buffered_;
+	size_t             budget_;
+	bool               stop_;
+	Mutex              mutex_;
+	Condition          cond_;
+	Vector<pthread_t>  threads_;
+};
+
+ParseQueue::ParseQueue(Vector<ParseJob*> const& jobs, size_t const n_workers) :
+	next_(0),
+	buffered_(0),
+	budget_(n_workers * buffer_budget),
+	stop_(false)
+{
+	if (n_workers == 0) return;
+
+	for (Vector<ParseJob*>::const_iterator i = jobs.begin(), end = jobs.end(); i != end; ++i) {
+		order_.push_back(*i);
+	}
+	std::stable_sort(order_.begin(), order_.end(), larger);
+
+	for (size_t i = 0; i != n_workers; ++i) {
+		pthread_t t;
+		if (pthread_create(&t, 0, worker, this) != 0) break;
+		threads_.push_back(t);
+	}
+}
+
+ParseQueue::~ParseQueue()
+{
+	{
+		Lock l(mutex_);
+		stop_ = true;
+		cond_.broadcast();
+	}
+	for (Vector<pthread_t>::const_iterator i = threads_.begin(), end = threads_.end(); i != end; ++i) {
+		pthread_join(*i, 0);
+	}
+}
+
+bool ParseQueue::steal(ParseJob& job)
+{
+	Lock l(mutex_);
+	if (job.state != ParseJob::JOB_PENDING) return false;
+	job.state = ParseJob::JOB_RUNNING;
+	return true;
+}
+
+void ParseQueue::wait(ParseJob& job)
+{
+	Lock l(mutex_);
+	while (job.state != ParseJob::JOB_DONE) {
+		cond_.wait(mutex_);
+	}
+}
+
+void ParseQueue::release(size_t const bytes)
+{
+	Lock l(mutex_);
+	buffered_ -= bytes;
+	cond_.broadcast();
+}
+
+void* ParseQueue::worker(void* const q)
+{
+	Arena::use_thread_arena();
+	static_cast<ParseQueue*>(q)->run();
+	return 0;
+}
+
+ParseJob* ParseQueue::claim()
+{
+	Lock l(mutex_);
+	while (!stop_ && buffered_ > budget_) {
+		cond_.wait(mutex_);
+	}
+	while (!stop_ && next_ != order_.size()) {
+		ParseJob* const job = order_[next_++];
+		if (job->state != ParseJob::JOB_PENDING) continue;
+		job->state = ParseJob::JOB_RUNNING;
+		return job;
+	}
+	return 0;
+}
+
+void ParseQueue::run()
+{
+	while (ParseJob* const job = claim()) {
+		try {
+			job->parse.start();
+			parse_job(*job);
+			job->parse.stop();
+			if (parse_only) {
+				// The record holds the texts now.
+				release_texts(*job);
+			} else {
+				job->reconstruct.start();
+				switch (output_format) {
+					case OUT_GIT: {
+						BufferBlob b(*job);
+						reconstruct_blobs(job->file, b);
+						// Streaming needs the texts again.
+						if (!job->stream) release_texts(*job);
+						break;
+					}
+
+					case OUT_SVN:
+						take_snapshots(job->file);
+						break;
+				}
+				job->reconstruct.stop();
+			}
+		} catch (std::exception const& e) {
+			job->error = e.what();
+		}
+
+		Lock l(mutex_);
+		buffered_  += job->blobs.size() + job->record.size();
+		job->state  = ParseJob::JOB_DONE;
+		cond_.broadcast();
+	}
+}
+
+/* The time spent on the files by the workers and the main thread, for -p
+ * and -P. */
+struct BusyTime
+{
+	BusyTime() : n_files(), n_bytes(), parse(), reconstruct() {}
+
+	void add(ParseJob const& job)
+	{
+		++n_files;
+		n_bytes += job.size;
+		parse   += job.parse.seconds();
+		trace_span("parse", job.parse, job.path);
+		if (job.reconstruct.thread != 0) {
+			reconstruct += job.reconstruct.seconds();
+			trace_span("reconstruct", job.reconstruct, job.path);
+		}
+	}
+
+	void count(Phase& p) const
+	{
+		p.count("files", n_files);
+		p.bytes(n_bytes);
+		p.busy("parse", parse);
+		p.busy("reconstruct", reconstruct);
+	}
+
+	size_t n_files;
+	u8     n_bytes;
+	double parse;
+	double reconstruct;
+};
+
+#ifdef __APPLE__
+typedef FTSENT const**       FTSENT_cmp;
+#else
+typedef FTSENT const* const* FTSENT_cmp;
+#endif
+
+static int compar(FTSENT_cmp const a, FTSENT_cmp const b)
+{
+	return
+		streq((*a)->fts_name, ATTIC) ? -1 :
+		streq((*b)->fts_name, ATTIC) ?  1 :
+		strcmp((*a)->fts_name, (*b)->fts_name);
+}
+
+/* Change sets with the same date and first file are ordered by the trunk
+ * revision of that file, so the order is total and does not depend on the
+ * order of the input. */
+static bool older_changeset(Changeset const* const a, Changeset const* const b)
+{
+	if (a->oldest == b->oldest) {
+		FileRev const* const fa = a->filerevs.front();
+		FileRev const* const fb = b->filerevs.front();
+		if (fa->file == fb->file) return *fa->rev < *fb->rev;
+		return fa->file->rank < fb->file->rank;
+	}
+
+	return a->oldest < b->oldest;
+}
+
+/* Compares the contents of symbols, not their addresses, which depend on the
+ * threads interning them.  Null comes first. */
+static int compare_symbols(Symbol const a, Symbol const b)
+{
+	if (a == b) return 0;
+	if (!a)     return -1;
+	if (!b)     return  1;
+	if (int const c = memcmp(a->data, b->data, std::min(a->size, b->size))) return c;
+	return a->size < b->size ? -1 : a->size > b->size;
+}
+
+static bool bucket_order(Changeset const* const a, Changeset const* const b)
+{
+	if (int const c = compare_symbols(a->log,      b->log))      return c < 0;
+	if (int const c = compare_symbols(a->author,   b->author))   return c < 0;
+	if (int const c = compare_symbols(a->commitid, b->commitid)) return c < 0;
+	return a->bucket < b->bucket;
+}
+
+/* Join the change sets of neighbouring time slots, unless the gap between
+ * them exceeds the split threshold.  Revisions of slots further apart are
+ * always more than the threshold apart.  The joined change sets are deleted,
+ * so changesets must not be used afterwards. */
+static void join_buckets(Vector<Changeset*>& sets)
+{
+	Vector<Changeset*> grouped;
+	for (Set<Changeset*>::iterator i = changesets.begin(), end = changesets.end(); i != end; ++i) {
+		grouped.push_back(*i);
+	}
+	std::sort(grouped.begin(), grouped.end(), bucket_order);
+
+	for (Vector<Changeset*>::const_iterator i = grouped.begin(), end = grouped.end(); i != end; ++i) {
+		Changeset* const c = *i;
+		if (!sets.empty()) {
+			Changeset& p = *sets.back();
+			if (p.log == c->log && p.author == c->author && p.commitid == c->commitid && p.bucket + 1 == c->bucket &&
+					c->oldest.seconds() - p.newest.seconds() <= split_threshold) {
+				p.join(*c);
+				delete c;
+				continue;
+			}
+		}
+		sets.push_back(c);
+	}
+}
+
+static bool older_filerev(FileRev const* const a, FileRev const* const b)
+{
+	if (a->file == b->file) {
+		return *a->rev < *b->rev;
+	} else if (a->date == b->date) {
+		return a->file->rank < b->file->rank;
+	} else {
+		return a->date < b->date;
+	}
+}
+
+static char const* check_trunk_name(char const* const name)
+{
+	switch (*name) {
+		case '\0': throw std::runtime_error("trunk name must not be empty");
+		case '/':  throw std::runtime_error("trunk name must not start with a slash ('/')");
+		case '-':  throw std::runtime_error("trunk name must not start with a minus ('-')");
+		default:   break;
+	}
+
+	for (char const* i = name; *i != '\0'; ++i) {
+		if (*i == '/') {
+			switch (i[1]) {
+				case '\0': throw std::runtime_error("trunk name must not end with a slash ('/')");
+				case '/':  throw std::runtime_error("trunk name must not contain consecutive slashes ('//')");
+			}
+		} else if (!between('A', *i, 'Z') && !between('a', *i, 'z') && !between('0', *i, '9') && *i != '_' && *i != '+' && *i != '-' && *i != '.') {
+			throw std::runtime_error("trunk name may only contain letters, digits, underscore, plus, minus and period");
+		}
+	}
+
+	return name;
+}
+
+// Takes YYYY-MM-DD[ hh:mm:ss] as UTC, like the dates in RCS files.
+static Date check_date(char const* const s)
+{
+	unsigned y;
+	unsigned mo;
+	unsigned d;
+	unsigned h   = 0;
+	unsigned mi  = 0;
+	unsigned sec = 0;
+	int      n   = -1;
+	int      m   = -1;
+	if (sscanf(s, "%4u-%2u-%2u%n", &y, &mo, &d, &n) != 3 || n < 0 ||
+			(s[n] != '\0' && (s[n] != ' ' || sscanf(s + n + 1, "%2u:%2u:%2u%n", &h, &mi, &sec, &m) != 3 || m < 0 || s[n + 1 + m] != '\0')) ||
+			y < 1900) {
+		throw std::runtime_error("date must be of the form YYYY-MM-DD[ hh:mm:ss]");
+	}
+
+	// Years before 2000 only have two digits in RCS files.
+	char rcs[20];
+	snprintf(rcs, sizeof(rcs), "%02u.%02u.%02u.%02u.%02u.%02u", y < 2000 ? y - 1900 : y, mo, d, h, mi, sec);
+	uptr<Blob> const b(Blob::alloc(rcs));
+	return Date::parse(b.get());
+}
+
+// Changes with the layout of the records written by save_file().
+static char const record_layout[] = "2";
+
+// The records hold texts, which depend on the keywords to unexpand.
+static std::string records_fingerprint(char const* const kind)
+{
+	std::string fingerprint(kind, strlen(kind) + 1);
+	fingerprint.append(record_layout, sizeof(record_layout));
+	for (Vector<char const*>::const_iterator i = expand_keywords.begin(), end = expand_keywords.end(); i != end; ++i) {
+		fingerprint += *i;
+		fingerprint += '\0';
+	}
+	return fingerprint;
+}
+
+enum PathMatch
+{
+	MATCH_NONE,
+	MATCH_BELOW, // Only paths below may match
+	MATCH_PATH
+};
+
+/* Matches a pattern of -i or -x against a path given by its components.  A
+ * pattern without a slash matches a name at any depth, otherwise its
+ * components are matched from the root on.  A match of a parent directory is
+ * a match of the path. */
+static PathMatch match_path(char const* const pattern, Vector<char const*> const& path)
+{
+	if (!strchr(pattern, '/')) {
+		for (Vector<char const*>::const_iterator i = path.begin(), end = path.end(); i != end; ++i) {
+			if (fnmatch(pattern, *i, 0) == 0) return MATCH_PATH;
+		}
+		return MATCH_BELOW;
+	}
+
+	char const* p = pattern;
+	for (Vector<char const*>::const_iterator i = path.begin(), end = path.end(); i != end; ++i) {
+		while (*p == '/') ++p;
+		if (*p == '\0') return MATCH_PATH;
+		char const* e = strchr(p, '/');
+		if (!e) e = p + strlen(p);
+		if (fnmatch(std::string(p, e).c_str(), *i, 0) != 0) return MATCH_NONE;
+		p = e;
+	}
+	while (*p == '/') ++p;
+	return *p == '\0' ? MATCH_PATH : MATCH_BELOW;
+}
+
+/* Whether the file or directory name in dir is converted.  A directory is
+ * only pruned, if nothing below it can be selected. */
+static bool selected(Directory const* const dir, char const* const name, bool const is_dir)
+{
+	if (include_patterns.empty() && exclude_patterns.empty()) return true;
+
+	Vector<char const*> path(dir->depth + 1);
+	path[dir->depth] = name;
+	for (Directory const* d = dir; d->name; d = d->parent) {
+		path[d->depth - 1] = d->name;
+	}
+
+	for (Vector<char const*>::const_iterator i = exclude_patterns.begin(), end = exclude_patterns.end(); i != end; ++i) {
+		if (match_path(*i, path) == MATCH_PATH) return false;
+	}
+
+	if (include_patterns.empty()) return true;
+	for (Vector<char const*>::const_iterator i = include_patterns.begin(), end = include_patterns.end(); i != end; ++i) {
+		PathMatch const m = match_path(*i, path);
+		if (m == MATCH_PATH || (is_dir && m == MATCH_BELOW)) return true;
+	}
+	return false;
+}
+
+static bool is_executable(struct stat const& s)
+{
+	return s.st_mode & (S_IXUSR | S_IXGRP | S_IXOTH);
+}
+
+static size_t log2(size_t const v)
+{
+	return
+		v <         10 ? 1 :
+		v <        100 ? 2 :
+		v <       1000 ? 3 :
+		v <      10000 ? 4 :
+		v <     100000 ? 5 :
+		v <    1000000 ? 6 :
+		v <   10000000 ? 7 :
+		v <  100000000 ? 8 :
+		v < 1000000000 ? 9 :
+		10;
+}
+
+static void add_dir_entry(char const* const prefix, Vector<size_t>& n_entries, Directory* const d)
+{
+	if (d && n_entries[d->id]++ == 0) {
+		add_dir_entry(prefix, n_entries, d->parent);
+		out << "Node-path: " << prefix << '/' << *d << "\nNode-kind: dir\nNode-action: add\n\n";
+	}
+}
+
+static void del_dir_entry(char const* const prefix, Vector<size_t>& n_entries, Directory* const d)
+{
+	if (d && --n_entries[d->id] == 0) {
+		out << "Node-path: " << prefix << '/' << *d << "\nNode-kind: dir\nNode-action: delete\n\n";
+		del_dir_entry(prefix, n_entries, d->parent);
+	}
+}
+
+static bool older_tag(Tag const* const a, Tag const* const b)
+{
+	return b->latest->id < a->latest->id;
+}
+
+static bool tagged_rev_older(FileRev const* const a, FileRev const* const b)
+{
+	return b->changeset->id < a->changeset->id;
+}
+
+static void emit_svn_revision(size_t const revno, Date const& date, u1 const* const author, size_t const author_len, u1 const* const log, size_t const log_len)
+{
+	size_t const prop_len =
+		(author ? 5 + 11 + 2 + log2(author_len) + 1 + author_len + 1 : 0) + // svn:author
+		4 +  9 + 5 + 28 +                                                   // svn:date
+		4 +  7 + 2 + log2(log_len) + 1 + log_len + 1 +                      // svn:log
+		11;                                                                 // PROPS-END
+	out <<
+		"Revision-number: " << revno << "\n"
+		"Prop-content-length: " << prop_len << "\n"
+		"Content-length: " << prop_len << "\n"
+		"\n";
+	if (author) {
+		out << "K 10\nsvn:author\nV "  << author_len << '\n';
+		out.write(author, author_len);
+		out << '\n';
+	}
+	out << "K 8\nsvn:date\nV 27\n";
+	out.number(date.year,   4); out << '-';
+	out.number(date.month,  2); out << '-';
+	out.number(date.day,    2); out << 'T';
+	out.number(date.hour,   2); out << ':';
+	out.number(date.minute, 2); out << ':';
+	out.number(date.second, 2);
+	out <<
+		".000000Z\n"
+		"K 7\n"
+		"svn:log\n"
+		"V " << log_len << '\n';
+	out.write(log, log_len);
+	out <<
+		"\n"
+		"PROPS-END\n"
+		"\n";
+}
+
+template<typename T> static void sort_unique(Vector<T>& v)
+{
+	std::sort(v.begin(), v.end());
+	for (size_t const n = std::unique(v.begin(), v.end()) - v.begin(); v.size() != n;) {
+		v.pop_back();
+	}
+}
+
+// Position of p in the sorted v, which contains it.
+template<typename T> static u4 index_of(Vector<T> const& v, T const p)
+{
+	if (!p) return RecordWriter::NONE;
+	return std::lower_bound(v.begin(), v.end(), p) - v.begin();
+}
+
+// Position of c in sorted_changesets; changesets left out by the sort are put behind.
+static u4 changeset_index(Vector<Changeset*> const& sorted_changesets, Changeset const* const c)
+{
+	if (!c) return RecordWriter::NONE;
+	if (c->id < sorted_changesets.size() && sorted_changesets[c->id] == c) return c->id;
+	return sorted_changesets.size();
+}
+
+/* Store everything emit_dump() needs for git output, so a conversion can be
+ * resumed without reading the RCS files again.  Files and revisions are
+ * numbered by their position in sorted arrays of pointers.  Of the revisions
+ * merely linked to, only the state and the changeset matter. */
+static void save_snapshot(RecordWriter& w, Vector<Changeset*> const& sorted_changesets, Vector<Tag*> const& sorted_tags, u4 const mark, u4 const trunk_tip)
+{
+	Vector<FileRev const*> linked;
+	for (Vector<Changeset*>::const_iterator i = sorted_changesets.begin(), end = sorted_changesets.end(); i != end; ++i) {
+		Vector<FileRev*> const& fr = (*i)->filerevs;
+		for (Vector<FileRev*>::const_iterator i = fr.begin(), end = fr.end(); i != end; ++i) {
+			linked.push_back(*i);
+		}
+	}
+	for (Vector<Tag*>::const_iterator i = sorted_tags.begin(), end = sorted_tags.end(); i != end; ++i) {
+		Vector<FileRev*> const& fr = (*i)->filerevs;
+		for (Vector<FileRev*>::const_iterator i = fr.begin(), end = fr.end(); i != end; ++i) {
+			linked.push_back(*i);
+		}
+	}
+	sort_unique(linked);
+
+	Vector<FileRev const*> revs;
+	for (Vector<FileRev const*>::const_iterator i = linked.begin(), end = linked.end(); i != end; ++i) {
+		FileRev const& r = **i;
+		revs.push_back(&r);
+		if (r.pred) revs.push_back(r.pred);
+		if (r.next) revs.push_back(r.next);
+	}
+	sort_unique(revs);
+
+	Vector<File const*> files;
+	for (Vector<FileRev const*>::const_iterator i = revs.begin(), end = revs.end(); i != end; ++i) {
+		files.push_back((*i)->file);
+	}
+	sort_unique(files);
+
+	w.put_bytes(reinterpret_cast<u1 const*>(trunk_name), strlen(trunk_name));
+	w.put_bytes(reinterpret_cast<u1 const*>(email_domain), strlen(email_domain));
+	w.put<u4>(mark);
+	w.put<u4>(trunk_tip);
+
+	w.put<u4>(files.size());
+	for (Vector<File const*>::const_iterator i = files.begin(), end = files.end(); i != end; ++i) {
+		File const&        f = **i;
+		std::ostringstream path;
+		static_cast<std::ostream&>(path) << f;
+		w.put_bytes(reinterpret_cast<u1 const*>(path.str().data()), path.str().size());
+		w.put<u1>(f.executable);
+	}
+
+	w.put<u4>(revs.size());
+	for (Vector<FileRev const*>::const_iterator i = revs.begin(), end = revs.end(); i != end; ++i) {
+		FileRev const& r      = **i;
+		bool    const  follow = std::binary_search(linked.begin(), linked.end(), &r);
+		w.put<u4>(index_of(files, r.file));
+		w.put<u1>(r.state);
+		w.put<u4>(r.mark);
+		w.put<u4>(changeset_index(sorted_changesets, r.changeset));
+		w.put<u4>(index_of<FileRev const*>(revs, follow ? r.pred : 0));
+		w.put<u4>(index_of<FileRev const*>(revs, follow ? r.next : 0));
+	}
+
+	w.put<u4>(sorted_changesets.size());
+	for (Vector<Changeset*>::const_iterator i = sorted_changesets.begin(), end = sorted_changesets.end(); i != end; ++i) {
+		Changeset const& c = **i;
+		w.put_blob(c.log);
+		w.put_blob(c.author);
+		w.put<u2>(c.oldest.year);
+		w.put<u1>(c.oldest.month);
+		w.put<u1>(c.oldest.day);
+		w.put<u1>(c.oldest.hour);
+		w.put<u1>(c.oldest.minute);
+		w.put<u1>(c.oldest.second);
+		w.put<u4>(c.filerevs.size());
+		for (Vector<FileRev*>::const_iterator i = c.filerevs.begin(), end = c.filerevs.end(); i != end; ++i) {
+			w.put<u4>(index_of<FileRev const*>(revs, *i));
+		}
+	}
+
+	w.put<u4>(sorted_tags.size());
+	for (Vector<Tag*>::const_iterator i = sorted_tags.begin(), end = sorted_tags.end(); i != end; ++i) {
+		Tag const& t = **i;
+		u4 const   l = changeset_index(sorted_changesets, t.latest);
+		w.put_blob(t.name);
+		w.put<u4>(l == sorted_changesets.size() ? RecordWriter::NONE : l);
+		w.put<u4>(t.filerevs.size());
+		for (Vector<FileRev*>::const_iterator i = t.filerevs.begin(), end = t.filerevs.end(); i != end; ++i) {
+			w.put<u4>(index_of<FileRev const*>(revs, *i));
+		}
+	}
+}
+
+template<typename T> static T* checkpoint_at(Vector<T*> const& v, u4 const i)
+{
+	if (i == RecordWriter::NONE) return 0;
+	if (i >= v.size()) throw std::runtime_error("corrupt checkpoint");
+	return v[i];
+}
+
+static char const* load_string(RecordReader& r)
+{
+	size_t          size;
+	u1 const* const data = r.get_bytes(size);
+	if (!data) throw std::runtime_error("corrupt checkpoint");
+	return Arena::current().strdup(std::string(reinterpret_cast<char const*>(data), size).c_str());
+}
+
+// The counterpart of save_snapshot().
+static void load_snapshot(RecordReader& r, Vector<Changeset*>& sorted_changesets, Vector<Tag*>& sorted_tags, u4& mark, u4& trunk_tip)
+{
+	trunk_name   = load_string(r);
+	email_domain = load_string(r);
+	mark         = r.get<u4>();
+	trunk_tip    = r.get<u4>();
+
+	Vector<File*> files;
+	for (u4 n = r.get<u4>(); n != 0; --n) {
+		char const* const path = load_string(r);
+		files.push_back(new File(path, 0, r.get<u1>() != 0));
+	}
+
+	// Links may point forward, so they are resolved once all revisions and changesets exist.
+	Vector<FileRev*> revs;
+	Vector<u4>       links;
+	for (u4 n = r.get<u4>(); n != 0; --n) {
+		File* const f = checkpoint_at(files, r.get<u4>());
+		if (!f) throw std::runtime_error("corrupt checkpoint");
+		FileRev* const rev = new FileRev(f, 0);
+		rev->state = r.get<u1>() == STATE_DEAD ? STATE_DEAD : STATE_EXP;
+		rev->mark  = r.get<u4>();
+		links.push_back(r.get<u4>());
+		links.push_back(r.get<u4>());
+		links.push_back(r.get<u4>());
+		revs.push_back(rev);
+	}
+
+	for (u4 n = r.get<u4>(); n != 0; --n) {
+		Symbol     const log    = load_symbol(r);
+		Symbol     const author = load_symbol(r);
+		Changeset* const c      = new Changeset(log, author);
+		c->oldest.year   = r.get<u2>();
+		c->oldest.month  = r.get<u1>();
+		c->oldest.day    = r.get<u1>();
+		c->oldest.hour   = r.get<u1>();
+		c->oldest.minute = r.get<u1>();
+		c->oldest.second = r.get<u1>();
+		c->id            = sorted_changesets.size();
+		for (u4 n = r.get<u4>(); n != 0; --n) {
+			FileRev* const rev = checkpoint_at(revs, r.get<u4>());
+			if (!rev) throw std::runtime_error("corrupt checkpoint");
+			c->hold(rev);
+		}
+		sorted_changesets.push_back(c);
+	}
+
+	// Stands in for the changesets left out by the sort, which have no id.
+	Changeset* const unsorted = new Changeset(0, 0);
+	for (size_t i = 0; i != revs.size(); ++i) {
+		u4 const c = links[3 * i];
+		revs[i]->changeset = c == sorted_changesets.size() ? unsorted : checkpoint_at(sorted_changesets, c);
+		revs[i]->pred      = checkpoint_at(revs, links[3 * i + 1]);
+		revs[i]->next      = checkpoint_at(revs, links[3 * i + 2]);
+	}
+
+	for (u4 n = r.get<u4>(); n != 0; --n) {
+		Tag* const t = new Tag(load_symbol(r));
+		t->latest = checkpoint_at(sorted_changesets, r.get<u4>());
+		for (u4 n = r.get<u4>(); n != 0; --n) {
+			FileRev* const rev = checkpoint_at(revs, r.get<u4>());
+			if (!rev) throw std::runtime_error("corrupt checkpoint");
+			t->add(rev);
+		}
+		sorted_tags.push_back(t);
+	}
+
+	if (!r.done()) throw std::runtime_error("corrupt checkpoint");
+}
+
+/* The latest revision of each file seen since the last clear().  Clearing
+ * only starts a new epoch, so nothing is allocated per change set. */
+class SeenFiles
+{
+public:
+	SeenFiles() : marks_(File::n_ids()), epoch_(1) {}
+
+	FileRev const* find(File const* const f) const
+	{
+		Mark const& m = marks_[f->id];
+		return m.epoch == epoch_ ? m.rev : 0;
+	}
+
+	void insert(FileRev const* const r)
+	{
+		Mark& m = marks_[r->file->id];
+		m.epoch = epoch_;
+		m.rev   = r;
+	}
+
+	void clear()
+	{
+		if (++epoch_ != 0) return;
+		for (Vector<Mark>::iterator i = marks_.begin(), end = marks_.end(); i != end; ++i) {
+			i->epoch = 0;
+		}
+		epoch_ = 1;
+	}
+
+private:
+	struct Mark
+	{
+		Mark() : epoch(), rev() {}
+
+		u4             epoch;
+		FileRev const* rev;
+	};
+
+	Vector<Mark> marks_;
+	u4           epoch_;
+};
+
+/* Split a change set, where the gap between two revisions exceeds the split
+ * threshold or where a file comes again.  The pieces are appended to
+ * splitsets.  A revision, whose predecessor is in the same piece, is folded
+ * into it as a fixup.  This only touches the change set and its revisions,
+ * so change sets can be split by several threads at once. */
+static void split_changeset(Changeset* const c, Vector<Changeset*>& splitsets, SeenFiles& contains, std::ostream& diag)
+{
+#if DEBUG_SPLIT
+	Date       const& o = c->oldest;
+	Date       const& n = c->newest;
+	cerr << endl << c << ' ' << o << ' ' << n << ' ' << *c->author << ' ' << c->filerevs.size() << (o != n ? " !!!" : "") << endl;
+	cerr << "---\n" << *c->log << "\n---\n";
+#endif
+
+	if (c->commitid) {
+		// The revisions of one commit, so there is nothing to split.
+		splitsets.push_back(c);
+		return;
+	}
+
+	Vector<FileRev*>::iterator const rbegin = c->filerevs.begin();
+	Vector<FileRev*>::iterator const rend   = c->filerevs.end();
+
+	std::sort(rbegin, rend, older_filerev);
+	contains.clear();
+
+	/* The revisions of a file are ordered by number, so the predecessor of a
+	 * revision is in the change set, iff it is the latest one seen. */
+	bool need_split = false;
+	u4   last       = (*rbegin)->date.seconds();
+	for (Vector<FileRev*>::const_iterator i = rbegin; i != rend; ++i) {
+		FileRev&             f    = **i;
+		u4             const now  = f.date.seconds();
+		FileRev const* const seen = contains.find(f.file);
+		if (now - last > split_threshold) {
+			goto need_split;
+		} else if (seen) {
+			if (f.pred && f.pred == seen) {
+				need_split = true;
+#if DEBUG_SPLIT
+				cerr << "vvv fixup vvv\n";
+#else
+				break;
+#endif
+			} else {
+need_split:
+				need_split = true;
+#if DEBUG_SPLIT
+				contains.clear();
+				cerr << "--- split ---\n";
+#else
+				break;
+#endif
+				goto insert;
+			}
+		} else {
+insert:
+			contains.insert(&f);
+		}
+		last = now;
+#if DEBUG_SPLIT
+		cerr << "  " << f.date << ' ' << f.state << ' ' << *f.rev;
+		if (FileRev const* pred = f.pred)
+			cerr << " <- " << *pred->rev;
+		cerr << ' ' << *f.file << endl;
+#endif
+	}
+
+	if (!need_split) {
+		splitsets.push_back(c);
+		return;
+	}
+
+	last = (*rbegin)->date.seconds();
+	Changeset* newset = new Changeset(c->log, c->author);
+	contains.clear();
+	for (Vector<FileRev*>::const_iterator i = rbegin; i != rend; ++i) {
+		FileRev&             f    = **i;
+		u4             const now  = f.date.seconds();
+		FileRev const* const seen = contains.find(f.file);
+		if (now - last > split_threshold) {
+			goto do_split;
+		} else if (seen) {
+			if (f.pred && f.pred == seen) {
+				f.pred = f.pred->pred;
+				contains.insert(&f);
+				diag << CLEAR "note: treating " << *f.file << ' ' << *f.rev << " as fixup commit\n";
+			} else {
+do_split:
+				contains.clear();
+				splitsets.push_back(newset);
+				newset = new Changeset(c->log, c->author);
+				goto do_insert;
+			}
+		} else {
+do_insert:
+			contains.insert(&f);
+		}
+		last = now;
+		newset->add(&f);
+	}
+	splitsets.push_back(newset);
+	delete c;
+}
+
+struct SplitChunk
+{
+	SplitChunk(size_t const begin, size_t const end) : begin(begin), end(end) {}
+
+	size_t const       begin;
+	size_t const       end;
+	Vector<Changeset*> splitsets;
+	std::ostringstream diag;
+};
+
+/* The change sets are split in chunks, which the threads take in order.  The
+ * results are concatenated in the same order, so they do not depend on the
+ * number of threads. */
+struct SplitWork
+{
+	SplitWork(Vector<Changeset*> const& sets) : sets(sets), next(0), n_done(0), n_split(0) {}
+
+	Vector<Changeset*> const& sets;
+	Vector<SplitChunk*>       chunks;
+	size_t                    next;
+	size_t                    n_done;
+	size_t                    n_split;
+	Mutex                     mutex;
+};
+
+static void split_chunks(SplitWork& w, bool const show_progress)
+{
+	SeenFiles contains;
+	for (;;) {
+		SplitChunk* chunk;
+		{
+			Lock l(w.mutex);
+			if (w.next == w.chunks.size()) return;
+			chunk = w.chunks[w.next++];
+		}
+
+		for (size_t i = chunk->begin; i != chunk->end; ++i) {
+			split_changeset(w.sets[i], chunk->splitsets, contains, chunk->diag);
+		}
+
+		Lock l(w.mutex);
+		w.n_done  += chunk->end - chunk->begin;
+		w.n_split += chunk->splitsets.size();
+		if (show_progress) cerr << CLEAR "splitting... " << w.n_done << " -> " << w.n_split;
+	}
+}
+
+static void* split_worker(void* const w)
+{
+	Arena::use_thread_arena();
+	split_chunks(*static_cast<SplitWork*>(w), false);
+	return 0;
+}
+
+static size_t const split_chunk_size = 1000;
+
+static void split_changesets(Vector<Changeset*> const& sets, Vector<Changeset*>& splitsets, size_t const n_workers)
+{
+	SplitWork w(sets);
+	for (size_t i = 0; i < sets.size(); i += split_chunk_size) {
+		w.chunks.push_back(new SplitChunk(i, std::min(i + split_chunk_size, sets.size())));
+	}
+
+	Vector<pthread_t> threads;
+	for (size_t i = 0; i != n_workers && i + 1 < w.chunks.size(); ++i) {
+		pthread_t t;
+		if (pthread_create(&t, 0, split_worker, &w) != 0) break;
+		threads.push_back(t);
+	}
+	split_chunks(w, true);
+	for (Vector<pthread_t>::const_iterator i = threads.begin(), end = threads.end(); i != end; ++i) {
+		pthread_join(*i, 0);
+	}
+
+	for (Vector<SplitChunk*>::const_iterator i = w.chunks.begin(), end = w.chunks.end(); i != end; ++i) {
+		SplitChunk* const chunk = *i;
+		cerr << chunk->diag.str();
+		for (Vector<Changeset*>::const_iterator k = chunk->splitsets.begin(), kend = chunk->splitsets.end(); k != kend; ++k) {
+			splitsets.push_back(*k);
+		}
+		delete chunk;
+	}
+	cerr << CLEAR "splitting... " << sets.size() << " -> " << splitsets.size() << '\n';
+}
+
+/* The dependencies between the change sets, which are numbered by their
+ * position in sets.  The predecessors of change set i are edges[first[i]] to
+ * edges[first[i + 1] - 1]. */
+struct DependencyGraph
+{
+	DependencyGraph(Vector<Changeset*> const& sets);
+
+	Vector<u4> first;
+	Vector<u4> edges;
+	Vector<u4> n_succ;
+};
+
+DependencyGraph::DependencyGraph(Vector<Changeset*> const& sets) :
+	first(sets.size() + 1),
+	n_succ(sets.size())
+{
+	size_t const n = sets.size();
+	for (size_t i = 0; i != n; ++i) {
+		Changeset const& c = *sets[i];
+		first[i] = edges.size();
+		for (Vector<FileRev*>::const_iterator k = c.filerevs.begin(), end = c.filerevs.end(); k != end; ++k) {
+			FileRev const& f = **k;
+			assert(!f.pred || f.pred->changeset != f.changeset);
+			if (!f.pred || f.pred->converted) continue;
+			size_t const pred = f.pred->changeset->id;
+			edges.push_back(pred);
+			++n_succ[pred];
+		}
+	}
+	first[n] = edges.size();
+}
+
+/* Tarjan's algorithm without recursion, so deep dependency chains cannot
+ * overflow the stack.  Assigns each change set the number of its strongly
+ * connected component and returns the number of components. */
+static size_t find_components(DependencyGraph const& g, Vector<u4>& comp)
+{
+	size_t const n = comp.size();
+	Vector<u4> index(n);    // Order of the first visit, starting at 1
+	Vector<u4> low(n);
+	Vector<u4> next(n);     // Next edge to follow
+	Vector<u1> on_stack(n);
+	Vector<u4> stack;       // Visited, but not assigned to a component yet
+	Vector<u4> path;        // Current path of the depth-first search
+	u4     n_visited = 0;
+	size_t n_comps   = 0;
+	for (size_t root = 0; root != n; ++root) {
+		if (index[root] != 0) continue;
+
+		u4 v = root;
+visit:
+		index[v]    = low[v] = ++n_visited;
+		next[v]     = g.first[v];
+		on_stack[v] = 1;
+		stack.push_back(v);
+		path.push_back(v);
+
+		while (!path.empty()) {
+			v = path.back();
+			if (next[v] != g.first[v + 1]) {
+				u4 const w = g.edges[next[v]++];
+				if (index[w] == 0) {
+					v = w;
+					goto visit;
+				} else if (on_stack[w] && index[w] < low[v]) {
+					low[v] = index[w];
+				}
+				continue;
+			}
+
+			path.pop_back();
+			if (!path.empty() && low[v] < low[path.back()]) {
+				low[path.back()] = low[v];
+			}
+			if (low[v] == index[v]) {
+				u4 w;
+				do {
+					w = stack.back();
+					stack.pop_back();
+					on_stack[w] = 0;
+					comp[w]     = n_comps;
+				} while (w != v);
+				++n_comps;
+			}
+		}
+	}
+	return n_comps;
+}
+
+/* Split change set i, which is part of a dependency cycle, in two.  The
+ * revisions, whose predecessors are in the cycle, go into the second one,
+ * the others into the first one.  If all or none of them depend on the
+ * cycle, the revisions are split at the largest gap in time instead. */
+static void split_cycle(Vector<Changeset*>& sets, size_t const i, Vector<u4> const& comp, size_t const n_members)
+{
+	Changeset* const c = sets[i];
+	Vector<FileRev*>::iterator const rbegin = c->filerevs.begin();
+	Vector<FileRev*>::iterator const rend   = c->filerevs.end();
+
+	std::sort(rbegin, rend, older_filerev);
+	Vector<u1> later(c->filerevs.size());
+	size_t     n_later = 0;
+	for (size_t k = 0; k != later.size(); ++k) {
+		FileRev const& f = *c->filerevs[k];
+		if (f.pred && !f.pred->converted && comp[f.pred->changeset->id] == comp[i]) {
+			later[k] = 1;
+			++n_later;
+		}
+	}
+	if (n_later == 0 || n_later == later.size()) {
+		size_t cut = 1;
+		u4     gap = 0;
+		for (size_t k = 1; k != later.size(); ++k) {
+			u4 const d = c->filerevs[k]->date.seconds() - c->filerevs[k - 1]->date.seconds();
+			if (d > gap) {
+				gap = d;
+				cut = k;
+			}
+		}
+		for (size_t k = 0; k != later.size(); ++k) {
+			later[k] = k >= cut;
+		}
+	}
+
+	cerr << CLEAR "note: splitting change set by " << *c->author << " at " << c->oldest << " to break a dependency cycle of " << n_members << " change sets\n";
+
+	Changeset* const a = new Changeset(c->log, c->author, c->commitid);
+	Changeset* const b = new Changeset(c->log, c->author, c->commitid);
+	for (size_t k = 0; k != later.size(); ++k) {
+		(later[k] ? b : a)->add(c->filerevs[k]);
+	}
+	sets[i] = a;
+	sets.push_back(b);
+	delete c;
+}
+
+/* Split one change set of each dependency cycle.  Returns whether there was
+ * any cycle. */
+static bool break_cycles(Vector<Changeset*>& sets, DependencyGraph const& g)
+{
+	size_t const n = sets.size();
+	Vector<u4>   comp(n);
+	size_t const n_comps = find_components(g, comp);
+	if (n_comps == n) return false;
+
+	Vector<u4> n_members(n_comps);
+	for (size_t i = 0; i != n; ++i) {
+		++n_members[comp[i]];
+	}
+
+	// The oldest change set of a cycle, which has several revisions, is split.
+	Vector<u1> done(n_comps);
+	for (size_t i = 0; i != n; ++i) {
+		u4 const k = comp[i];
+		if (n_members[k] == 1 || done[k] || sets[i]->filerevs.size() < 2) continue;
+		done[k] = 1;
+		split_cycle(sets, i, comp, n_members[k]);
+	}
+	return true;
+}
+
+/* Order the change sets topologically.  Starting at the ones without
+ * successors, the newest change set, whose successors are all done, comes
+ * next.  The change sets are numbered by their position in older_changeset
+ * order, so the predecessor edges are a flat array of these numbers and the
+ * heap only compares integers.  Dependency cycles are broken first, because
+ * their change sets would never become ready. */
+static void sort_changesets(Vector<Changeset*>& sets, Vector<Changeset*>& sorted)
+{
+	for (;;) {
+		std::sort(sets.begin(), sets.end(), older_changeset);
+		size_t const n = sets.size();
+		for (size_t i = 0; i != n; ++i) {
+			sets[i]->id = i;
+		}
+
+		DependencyGraph g(sets);
+		if (break_cycles(sets, g)) continue;
+
+		Heap<u4, std::less<u4>, 4> roots;
+		for (size_t i = 0; i != n; ++i) {
+			if (g.n_succ[i] == 0) roots.push(i);
+		}
+
+#if DEBUG_SPLIT
+		cerr << "\nsorted:\n";
+#endif
+		while (!roots.empty()) {
+			u4 const i = roots.front();
+			roots.pop();
+
+			Changeset& c = *sets[i];
+			c.id = sorted.size();
+			sorted.push_back(&c);
+
+#if DEBUG_SPLIT
+			cerr << &c << ' ' << c.oldest << ' ' << c.newest << ' ' << *c.author << ' ' << c.filerevs.size() << endl;
+#endif
+
+			for (u4 k = g.first[i]; k != g.first[i + 1]; ++k) {
+				u4 const pred = g.edges[k];
+				if (--g.n_succ[pred] == 0) roots.push(pred);
+			}
+
+			if (sorted.size() % 1000 == 0) {
+				cerr << CLEAR "sorting... " << sorted.size();
+			}
+		}
+		cerr << CLEAR "sorting... " << sorted.size() << '\n';
+		assert(sorted.size() == n);
+		return;
+	}
+}
+
+/* Do not emit empty changesets.
+ * Skip changesets, which only add files which are dead and were dead before or
+ * did not exist. */
+static bool is_empty(Changeset const& c)
+{
+	for (Vector<FileRev*>::const_iterator i = c.filerevs.begin(), end = c.filerevs.end(); i != end; ++i) {
+		FileRev const& r = **i;
+		if (r.state == STATE_DEAD && (!r.pred || r.pred->state == STATE_DEAD)) continue;
+		return false;
+	}
+	return true;
+}
+
+// Number of commits between two checkpoints, see -c.
+static size_t const checkpoint_interval = 1000;
+
+static void emit_dump(Vector<Changeset*> const& sorted_changesets, Vector<Tag*> const& sorted_tags, Directory const* const root, size_t const content_budget, u4& mark, u4& trunk_tip, CheckpointWriter* const checkpoint, Progress const* const resume)
+{
+	Vector<size_t> n_dir_entries(Directory::n_dirs());
+	ContentCache   contents(content_budget << 20);
+
+	if (output_format == OUT_SVN) {
+		out << "SVN-fs-dump-format-version: 2\n\n";
+
+		// Nothing but the directories, if the window holds no changes.
+		Date const& d = sorted_changesets.empty() ? window_since : sorted_changesets.front()->oldest;
+		static u1 const log[] = "Standard project directories initialized by cvscvt.";
+		emit_svn_revision(1, d, 0, 0, log, sizeof(log) - 1);
+		out <<
+			"Node-path: " << trunk_name << "\n"
+			"Node-kind: dir\n"
+			"Node-action: add\n"
+			"\n"
+			"Node-path: " << tags_name << "\n"
+			"Node-kind: dir\n"
+			"Node-action: add\n"
+			"\n";
+		n_dir_entries[root->id] = 1;
+	}
+
+	u4 const date1970 = Date(1970, 1, 1, 0, 0, 0).seconds();
+	u4       from     = trunk_tip; // Continue an incremental conversion
+	size_t n_commits = 0;
+	size_t n_tags    = 0;
+
+	Vector<Tag*>::const_iterator             ti    = sorted_tags.begin();
+	Vector<Tag*>::const_iterator       const tend  = sorted_tags.end();
+	Changeset const*                         tnext = ti != tend ? (*ti)->latest : 0;
+	Vector<Changeset*>::const_iterator const begin = sorted_changesets.begin();
+	Vector<Changeset*>::const_iterator const end   = sorted_changesets.end();
+	Vector<Changeset*>::const_iterator       i     = end;
+
+	Progress done; // As of the last checkpoint
+	if (resume) {
+		if (resume->position > sorted_changesets.size()) throw std::runtime_error("checkpoint does not match its snapshot");
+
+		// Go through the changesets emitted before without output to restore their marks.
+		for (Vector<Changeset*>::const_iterator const stop = end - resume->position; i != stop;) {
+			Changeset& c = **--i;
+			if (is_empty(c)) continue;
+
+			trunk_tip = c.mark = ++mark;
+			for (; &c == tnext; tnext = ++ti != tend ? (*ti)->latest : 0) ++n_tags;
+			++n_commits;
+		}
+
+		if (n_commits != resume->n_commits || n_tags != resume->n_tags || mark != resume->mark || trunk_tip != resume->trunk_tip) {
+			throw std::runtime_error("checkpoint does not match its snapshot");
+		}
+		from = trunk_tip;
+		done = *resume;
+		cerr << "resuming after " << n_commits << " commits, " << n_tags << " tags\n";
+	} else if (checkpoint) {
+		// Make sure the blobs are kept.
+		out << "checkpoint\n\n";
+		out.flush();
+		done = Progress(0, 0, 0, mark, trunk_tip);
+	}
+
+	while (i != begin) {
+		Changeset& c = **--i;
+
+		if (is_empty(c)) continue;
+
+		uptr<Blob> log(convert_log(*c.log));
+		switch (output_format) {
+			case OUT_GIT: {
+#ifdef DEBUG_EXPORT
+				out << "# " << c.oldest << '\n';
+#endif
+				out << "commit refs/heads/" << trunk_name << '\n';
+				out << "mark :" << (c.mark = ++mark) << '\n';
+				out << "committer " << *c.author << " <" << *c.author << "@" << email_domain << "> " << c.oldest.seconds() - date1970 << " +0000\n";
+				out << "data " << log->size << '\n';
+				out << *log << '\n';
+				if (from != 0) {
+					out << "from :" << from << '\n';
+					from = 0;
+				}
+				trunk_tip = c.mark;
+				for (Vector<FileRev*>::const_iterator i = c.filerevs.begin(), end = c.filerevs.end(); i != end; ++i) {
+					FileRev const& r = **i;
+					// Skip file revisions which get a fixup in the same changeset.
+					if (r.next && r.next->changeset == r.changeset) continue;
+
+					File const& f = *r.file;
+					if (r.state == STATE_DEAD) {
+						out << "D " << f << '\n';
+					} else {
+						char const* const mode = f.executable ? "100755" : "100644";
+						out << "M " << mode << " :" << r.mark << ' ' << f << '\n';
+					}
+				}
+				break;
+			}
+
+			case OUT_SVN: {
+				Blob const& a = *c.author;
+				Blob const& l = *log;
+				emit_svn_revision(c.mark = n_commits + n_tags + 2, c.oldest, a.data, a.size, l.data, l.size);
+
+				for (Vector<FileRev*>::const_iterator i = c.filerevs.begin(), end = c.filerevs.end(); i != end; ++i) {
+					FileRev& r = **i;
+					// Skip file revisions which get a fixup in the same changeset.
+					if (r.next && r.next->changeset == r.changeset) continue;
+
+					File const& f         = *r.file;
+					bool const  cur_dead  = r.state == STATE_DEAD;
+					bool const  pred_dead = !r.pred || r.pred->state == STATE_DEAD || r.in_base; // The base tree adds all files
+
+					if (pred_dead && !cur_dead) {
+						add_dir_entry(trunk_name, n_dir_entries, f.dir);
+					}
+
+					if (!cur_dead) {
+						out << "Node-path: " << trunk_name << '/' << f << "\nNode-kind: file\n";
+						if (pred_dead) {
+							out << "Node-action: add\n";
+						} else {
+							out << "Node-action: change\n";
+						}
+
+						PieceTable const& content  = contents.get(&r);
+						size_t     const  text_len = content.size();
+						size_t       prop_len = 0;
+
+						bool const x = f.executable;
+						if (x) prop_len += 26;
+
+						if (prop_len != 0) {
+							prop_len += 10; // PROPS-END
+							out << "Prop-content-length: " << prop_len << '\n';
+						}
+						out << "Text-content-length: " << text_len            << '\n';
+						out << "Content-length: "      << prop_len + text_len << "\n\n";
+
+						if (prop_len != 0) {
+							if (x) {
+								out << "K 14\nsvn:executable\nV 1\n*\n";
+							}
+
+							out << "PROPS-END\n";
+						}
+
+						out << content;
+					} else if (!pred_dead) {
+						out << "Node-path: " << trunk_name << '/' << f << "\nNode-action: delete\n\n";
+						del_dir_entry(trunk_name, n_dir_entries, f.dir);
+					}
+				}
+
+				out << '\n';
+				break;
+			}
+		}
+
+		while (&c == tnext) {
+			Tag&              t  = **ti;
+			Vector<FileRev*>& fr = t.filerevs;
+
+			std::sort(fr.begin(), fr.end(), tagged_rev_older);
+
+			switch (output_format) {
+				case OUT_GIT: {
+					out << "commit refs/tags/" << *t.name << '\n';
+					out << "committer cvscvt <cvscvt@invalid> " << tnext->oldest.seconds() - date1970 << " +0000\n";
+					out << "data 9\n";
+					out << "Make tag\n\n";
+
+					FileRev const* min = fr.front();
+					FileRev const* max = fr.front()->next;
+					for (Vector<FileRev*>::const_iterator i = fr.begin(), end = fr.end(); i != end; ++i) {
+						FileRev const* const r = *i;
+						if (max && max->changeset->id >= r->changeset->id) {
+							out << "merge :" << min->changeset->mark << '\n';
+							goto set_max_git;
+						} else if (!max || (r->next && max->changeset->id < r->next->changeset->id)) {
+set_max_git:
+							max = r->next;
+						}
+						min = r;
+					}
+					out << "merge :" << min->changeset->mark << '\n';
+
+					out << "deleteall\n";
+
+					for (Vector<FileRev*>::const_iterator i = fr.begin(), end = fr.end(); i != end; ++i) {
+						FileRev const&       r    = **i;
+						File    const&       f    = *r.file;
+						char    const* const mode = f.executable ? "100755" : "100644";
+						out << "M " << mode << " :" << r.mark << ' ' << f << '\n';
+					}
+					break;
+				}
+
+				case OUT_SVN: {
+					std::string tag_path(tags_name);
+					tag_path += '/';
+					tag_path.append(reinterpret_cast<char const*>(t.name->data), t.name->size);
+
+					static u1 const log[] = "Make tag\n";
+					emit_svn_revision(n_commits + n_tags + 3, tnext->oldest, 0, 0, log, sizeof(log) - 1);
+
+					FileRev const*                   min      = fr.front();
+					FileRev const*                   max      = fr.front()->next;
+					Vector<size_t>                   n_tag_dir_entries(Directory::n_dirs());
+					Vector<FileRev*>::const_iterator next_out = fr.begin();
+					for (Vector<FileRev*>::const_iterator i = next_out, end = fr.end();; ++i) {
+						if (i == end) {
+							size_t const out_mark = min->changeset->mark;
+							for (; next_out != i; ++next_out) {
+								FileRev const& outr = **next_out;
+								File    const& outf = *outr.file;
+
+								add_dir_entry(tag_path.c_str(), n_tag_dir_entries, outf.dir);
+
+								out <<
+									"Node-path: " << tag_path << '/' << outf << "\n"
+									"Node-kind: file\n"
+									"Node-action: add\n"
+									"Node-copyfrom-rev: " << out_mark << "\n"
+									"Node-copyfrom-path: " << trunk_name << '/' << outf << "\n\n";
+							}
+							break;
+						}
+
+						FileRev const* const r = *i;
+						if (max && max->changeset->id >= r->changeset->id) {
+							size_t const out_mark = min->changeset->mark;
+							for (; next_out != i; ++next_out) {
+								FileRev const& outr = **next_out;
+								File    const& outf = *outr.file;
+
+								add_dir_entry(tag_path.c_str(), n_tag_dir_entries, outf.dir);
+
+								out <<
+									"Node-path: " << tag_path << '/' << outf << "\n"
+									"Node-kind: file\n"
+									"Node-action: add\n"
+									"Node-copyfrom-rev: " << out_mark << "\n"
+									"Node-copyfrom-path: " << trunk_name << '/' << outf << "\n\n";
+							}
+							goto set_max_svn;
+						} else if (!max || (r->next && max->changeset->id < r->next->changeset->id)) {
+set_max_svn:
+							max = r->next;
+						}
+						min = r;
+					}
+					out << "merge :" << min->changeset->mark << '\n';
+					break;
+				}
+			}
+
+			++n_tags;
+			tnext = ++ti != tend ? (*ti)->latest : 0;
+		}
+
+		if (++n_commits % 100 == 0) cerr << CLEAR "emitting... " << n_commits << " commits, " << n_tags << " tags " << c.oldest;
+
+		if (checkpoint && n_commits % checkpoint_interval == 0) {
+			out << "checkpoint\n\n";
+			out.flush();
+			/* fast-import may still be busy with this checkpoint, so only the
+			 * previous one is recorded.  If it gets further, the commits since are
+			 * emitted again on resumption, which is harmless, because they are
+			 * identical. */
+			checkpoint->save(done);
+			done = Progress(end - i, n_commits, n_tags, mark, trunk_tip);
+		}
+	}
+	cerr << CLEAR "emitting... " << n_commits << " commits, " << n_tags << " tags\n";
+
+	if (output_format == OUT_GIT) {
+		out << "done\n";
+	}
+	out.flush();
+}
+
+static bool lower_id(Directory const* const a, Directory const* const b)
+{
+	return a->id < b->id;
+}
+
+// Position of the directory in dirs; the root is not stored.
+static u4 dir_index(Vector<Directory const*> const& dirs, Directory const* const d)
+{
+	if (!d->parent) return RecordWriter::NONE;
+	return std::lower_bound(dirs.begin(), dirs.end(), d, lower_id) - dirs.begin();
+}
+
+/* Every shard (-S) describes the whole walk in the entry with the empty path,
+ * so the merge (-M) needs no access to the RCS files. */
+static void save_walk(RecordWriter& w, Vector<ParseJob*> const& jobs)
+{
+	// Parents come first, so they exist, when their subdirectories are loaded.
+	Vector<Directory const*> dirs;
+	for (Vector<ParseJob*>::const_iterator i = jobs.begin(), end = jobs.end(); i != end; ++i) {
+		for (Directory const* d = (*i)->file->dir; d->parent; d = d->parent) {
+			dirs.push_back(d);
+		}
+	}
+	std::sort(dirs.begin(), dirs.end(), lower_id);
+	for (size_t const n = std::unique(dirs.begin(), dirs.end()) - dirs.begin(); dirs.size() != n;) {
+		dirs.pop_back();
+	}
+
+	w.put<u4>(dirs.size());
+	for (Vector<Directory const*>::const_iterator i = dirs.begin(), end = dirs.end(); i != end; ++i) {
+		Directory const& d = **i;
+		w.put<u4>(dir_index(dirs, d.parent));
+		w.put_bytes(reinterpret_cast<u1 const*>(d.name), strlen(d.name));
+	}
+
+	w.put<u4>(jobs.size());
+	for (Vector<ParseJob*>::const_iterator i = jobs.begin(), end = jobs.end(); i != end; ++i) {
+		ParseJob const& job = **i;
+		File     const& f   = *job.file;
+		w.put_bytes(reinterpret_cast<u1 const*>(job.path), strlen(job.path));
+		w.put<u4>(dir_index(dirs, f.dir));
+		w.put_bytes(reinterpret_cast<u1 const*>(f.name), strlen(f.name));
+		w.put<u1>(f.executable);
+		w.put<u8>(job.key.size);
+		w.put<u8>(job.key.mtime);
+		w.put<u4>(job.key.mtime_nsec);
+	}
+}
+
+static std::string load_shard_string(RecordReader& r)
+{
+	size_t          size;
+	u1 const* const data = r.get_bytes(size);
+	if (!data) throw std::runtime_error("corrupt shard");
+	return std::string(reinterpret_cast<char const*>(data), size);
+}
+
+// The counterpart of save_walk().
+static void load_walk(RecordReader& r, Directory* const root, Vector<ParseJob*>& jobs)
+{
+	Vector<Directory*> dirs;
+	for (u4 n = r.get<u4>(); n != 0; --n) {
+		u4 const parent = r.get<u4>();
+		if (parent != RecordWriter::NONE && parent >= dirs.size()) throw std::runtime_error("corrupt shard");
+		dirs.push_back(new Directory(load_shard_string(r).c_str(), parent != RecordWriter::NONE ? dirs[parent] : root));
+	}
+
+	for (u4 n = r.get<u4>(); n != 0; --n) {
+		std::string const path = load_shard_string(r);
+		u4          const dir  = r.get<u4>();
+		if (dir != RecordWriter::NONE && dir >= dirs.size()) throw std::runtime_error("corrupt shard");
+		std::string const name       = load_shard_string(r);
+		bool        const executable = r.get<u1>() != 0;
+		CacheKey          key;
+		key.size       = r.get<u8>();
+		key.mtime      = r.get<u8>();
+		key.mtime_nsec = r.get<u4>();
+
+		File* const f = new File(name.c_str(), dir != RecordWriter::NONE ? dirs[dir] : root, executable);
+		jobs.push_back(new ParseJob(path.c_str(), f, key, false));
+	}
+
+	if (!r.done()) throw std::runtime_error("corrupt shard");
+}
+
+static bool path_order(ParseJob const* const a, ParseJob const* const b)
+{
+	return *a->file < *b->file;
+}
+
+/* Number the files in path order once, so the comparators only compare
+ * integers instead of walking the directories. */
+static void rank_files(Vector<ParseJob*> const& jobs)
+{
+	Vector<ParseJob*> order;
+	for (Vector<ParseJob*>::const_iterator i = jobs.begin(), end = jobs.end(); i != end; ++i) {
+		order.push_back(*i);
+	}
+	std::sort(order.begin(), order.end(), path_order);
+	for (size_t i = 0; i != order.size(); ++i) {
+		order[i]->file->rank = i;
+	}
+}
+
+static bool larger_job(ParseJob const* const a, ParseJob const* const b)
+{
+	return a->size > b->size;
+}
+
+/* Every shard computes the same distribution of the files: the largest goes
+ * to the shard with the fewest bytes so far.  The selected jobs stay in walk
+ * order. */
+static void select_shard(Vector<ParseJob*>& jobs, size_t const shard, size_t const n_shards)
+{
+	Vector<ParseJob*> order;
+	for (Vector<ParseJob*>::const_iterator i = jobs.begin(), end = jobs.end(); i != end; ++i) {
+		order.push_back(*i);
+	}
+	std::stable_sort(order.begin(), order.end(), larger_job);
+
+	Vector<u8>        load(n_shards);
+	Vector<ParseJob*> mine;
+	for (Vector<ParseJob*>::const_iterator i = order.begin(), end = order.end(); i != end; ++i) {
+		size_t min = 0;
+		for (size_t k = 1; k != n_shards; ++k) {
+			if (load[k] < load[min]) min = k;
+		}
+		load[min] += (*i)->size;
+		if (min == shard) mine.push_back(*i);
+	}
+	sort_unique(mine);
+
+	Vector<ParseJob*> selected;
+	for (Vector<ParseJob*>::const_iterator i = jobs.begin(), end = jobs.end(); i != end; ++i) {
+		if (std::binary_search(mine.begin(), mine.end(), *i)) {
+			selected.push_back(*i);
+		} else {
+			delete *i;
+		}
+	}
+	std::swap(jobs, selected);
+}
+
+// Rebuilds the walk described by the shards and finds the records of its files there.
+static void merge_shards(Vector<char const*> const& paths, Directory* const root, Vector<ParseJob*>& jobs, Vector<CacheReader*>& shards)
+{
+	std::string const fingerprint = records_fingerprint("shard");
+	u1 const*         walk        = 0;
+	u1 const*         walk_end    = 0;
+	for (Vector<char const*>::const_iterator i = paths.begin(), end = paths.end(); i != end; ++i) {
+		CacheReader* const s = new CacheReader(*i, fingerprint);
+		shards.push_back(s);
+
+		CacheKey  key;
+		u1 const* rec;
+		u1 const* rec_end;
+		if (!s->lookup("", key, rec, rec_end)) {
+			throw std::runtime_error(std::string("shard ") + *i + " is missing or unusable, e.g. written with other keywords");
+		}
+		if (!walk) {
+			walk     = rec;
+			walk_end = rec_end;
+		} else if (rec_end - rec != walk_end - walk || memcmp(rec, walk, rec_end - rec) != 0) {
+			throw std::runtime_error(std::string("shard ") + *i + " was written for another set of RCS files");
+		}
+	}
+
+	RecordReader r(walk, walk_end);
+	load_walk(r, root, jobs);
+
+	for (Vector<ParseJob*>::const_iterator i = jobs.begin(), end = jobs.end(); i != end; ++i) {
+		ParseJob& job = **i;
+		for (Vector<CacheReader*>::const_iterator s = shards.begin(), send = shards.end(); !job.cached; ++s) {
+			if (s == send) throw std::runtime_error(std::string("no shard holds ") + job.path);
+			(*s)->find(job.path, job.key, job.cached, job.cached_end);
+		}
+	}
+}
+
+// The trace of a failed run shows, where it failed.
+static void finish_failed_trace()
+{
+	try {
+		trace_finish();
+	} catch (std::exception const& e) {
+		cerr << "error: " << e.what() << endl;
+	}
+}
+
+int main(int argc, char** argv)
+try
+{
+	bool        unexpand_default = true;
+	size_t      n_jobs           = 1;
+	size_t      content_budget   = 256;
+	char const* cache_path       = 0;
+	char const* state_path       = 0;
+	char const* checkpoint_path  = 0;
+	char const* resume_path      = 0;
+	bool        windowed         = false;
+	size_t      shard            = 0;
+	size_t      n_shards         = 0;
+
+	Vector<char const*> merge_paths;
+	for (;;) {
+		switch (getopt(argc, argv, "C:DI:KM:P:S:T:a:c:e:f:i:j:k:m:pr:s:t:u:vx:")) {
+			case -1: goto done_opt;
+
+			case 'C': cache_path = optarg; break;
+
+			case 'D': dedup_blobs = true; break;
+
+			case 'I': state_path = optarg; break;
+
+			case 'K': unexpand_default = false; break;
+
+			case 'M': merge_paths.push_back(optarg); break;
+
+			case 'P': trace_open(optarg); break;
+
+			case 'S': {
+				char* end;
+				long const i = strtol(optarg, &end, 10);
+				long const n = *end == '/' ? strtol(end + 1, &end, 10) : 0;
+				if (*end != '\0' || i < 1 || n < i) {
+					cerr << "error: shard '" << optarg << "' is not of the form i/n with 1 <= i <= n\n";
+					return EXIT_FAILURE;
+				}
+				shard    = i - 1;
+				n_shards = n;
+				break;
+			}
+
+			case 'T': trunk_name = check_trunk_name(optarg); break;
+
+			case 'a':
+				window_since = check_date(optarg);
+				windowed     = true;
+				break;
+
+			case 'c': checkpoint_path = optarg; break;
+
+			case 'e': email_domain = optarg; break;
+
+			case 'f':
+				if (streq(optarg, "git")) {
+					output_format = OUT_GIT;
+				} else if (streq(optarg, "svn")) {
+					output_format = OUT_SVN;
+				} else {
+					cerr << "error: unknown output format '" << optarg << "'\n";
+					return EXIT_FAILURE;
+				}
+				break;
+
+			case 'i': include_patterns.push_back(optarg); break;
+
+			case 'j': {
+				char* end;
+				long const n = strtol(optarg, &end, 10);
+				if (optarg == end || *end != '\0' || n < 1) {
+					cerr << "error: number of jobs '" << optarg << "' is not a positive number\n";
+					return EXIT_FAILURE;
+				}
+				n_jobs = n;
+				break;
+			}
+
+			case 'k':
+				expand_keywords.push_back(optarg);
+				break;
+
+			case 'm': {
+				char* end;
+				long const n = strtol(optarg, &end, 10);
+				if (optarg == end || *end != '\0' || n < 0) {
+					cerr << "error: content cache size '" << optarg << "' is not a number\n";
+					return EXIT_FAILURE;
+				}
+				content_budget = n;
+				break;
+			}
+
+			case 'p': trace_print_stats(); break;
+
+			case 'r': resume_path = optarg; break;
+
+			case 's': {
+				char* end;
+				split_threshold = strtol(optarg, &end, 10);
+				if (optarg == end) {
+					cerr << "error: split threshold '" << optarg << "' is not a number\n";
+					return EXIT_FAILURE;
 				}
 				switch (*end) {
 					case '\0': break;
@@ -941,8 +3051,15 @@ try
 
 			case 't': tags_name = check_trunk_name(optarg); break;
 
+			case 'u':
+				window_until = check_date(optarg);
+				windowed     = true;
+				break;
+
 			case 'v': verbose = true; break;
 
+			case 'x': exclude_patterns.push_back(optarg); break;
+
 			case '?': return EXIT_FAILURE;
 		}
 	}
@@ -973,6 +3090,10 @@ done_opt:
 				cerr << "error: -t is not valid for git output\n";
 				return EXIT_FAILURE;
 			}
+			if (checkpoint_path && state_path) {
+				cerr << "error: -c is not valid together with -I\n";
+				return EXIT_FAILURE;
+			}
 			break;
 
 		case OUT_SVN:
@@ -980,12 +3101,90 @@ done_opt:
 				cerr << "error: -e is not valid for svn output\n";
 				return EXIT_FAILURE;
 			}
+			if (dedup_blobs) {
+				cerr << "error: -D is not valid for svn output\n";
+				return EXIT_FAILURE;
+			}
+			if (state_path) {
+				cerr << "error: -I is not valid for svn output\n";
+				return EXIT_FAILURE;
+			}
+			if (checkpoint_path) {
+				cerr << "error: -c is not valid for svn output\n";
+				return EXIT_FAILURE;
+			}
+			if (resume_path) {
+				cerr << "error: -r is not valid for svn output\n";
+				return EXIT_FAILURE;
+			}
 			if (!trunk_name) trunk_name = "trunk";
 			if (!tags_name)  tags_name  = "tags";
 			break;
 	}
 
-	if (argc == 0) return EXIT_FAILURE;
+	if (windowed) {
+		if (state_path || resume_path) {
+			cerr << "error: -a and -u are not valid together with -I or -r\n";
+			return EXIT_FAILURE;
+		}
+		if (!(window_since < window_until)) {
+			cerr << "error: the window of -a and -u is empty\n";
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (n_shards != 0 && (cache_path || state_path || checkpoint_path || resume_path || !merge_paths.empty())) {
+		cerr << "error: -S is not valid together with -C, -I, -M, -c or -r\n";
+		return EXIT_FAILURE;
+	}
+
+	if ((!include_patterns.empty() || !exclude_patterns.empty()) && (resume_path || !merge_paths.empty())) {
+		// The paths are selected while walking, so the shards would have to be written with them.
+		cerr << "error: -i and -x are not valid together with -M or -r\n";
+		return EXIT_FAILURE;
+	}
+
+	if (!merge_paths.empty()) {
+		if (cache_path || state_path || resume_path) {
+			cerr << "error: -M is not valid together with -C, -I or -r\n";
+			return EXIT_FAILURE;
+		}
+		if (argc != 0) {
+			cerr << "error: no paths are read, when merging shards with -M\n";
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (resume_path) {
+		if (argc != 0) {
+			cerr << "error: no paths are read, when resuming with -r\n";
+			return EXIT_FAILURE;
+		}
+
+		// The checkpoint provides everything else, including the trunk name.
+		Vector<Changeset*> sorted_changesets;
+		Vector<Tag*>       sorted_tags;
+		u4                 mark;
+		u4                 trunk_tip;
+		Progress           progress;
+		{
+			CheckpointReader const cp(resume_path);
+			RecordReader           r(cp.begin(), cp.end());
+			load_snapshot(r, sorted_changesets, sorted_tags, mark, trunk_tip);
+			progress = cp.progress();
+		}
+
+		CheckpointWriter checkpoint(resume_path);
+		{
+			Phase emit("emit");
+			emit_dump(sorted_changesets, sorted_tags, 0, content_budget, mark, trunk_tip, &checkpoint, &progress);
+			emit.count("changesets", sorted_changesets.size() - progress.position);
+		}
+		trace_finish();
+		return EXIT_SUCCESS;
+	}
+
+	if (argc == 0 && merge_paths.empty()) return EXIT_FAILURE;
 
 	Sym::Exp      = Lexer::add_keyword("Exp");
 	Sym::access   = Lexer::add_keyword("access");
@@ -993,6 +3192,7 @@ done_opt:
 	Sym::branch   = Lexer::add_keyword("branch");
 	Sym::branches = Lexer::add_keyword("branches");
 	Sym::comment  = Lexer::add_keyword("comment");
+	Sym::commitid = Lexer::add_keyword("commitid");
 	Sym::date     = Lexer::add_keyword("date");
 	Sym::dead     = Lexer::add_keyword("dead");
 	Sym::desc     = Lexer::add_keyword("desc");
@@ -1013,16 +3213,67 @@ done_opt:
 	Sym::o   = Lexer::add_keyword("o");
 	Sym::v   = Lexer::add_keyword("v");
 
-	FTS* const fts = fts_open(argv, FTS_PHYSICAL, compar);
-	if (!fts) throw std::runtime_error("fts_open failed");
+	if (window_since != Date()) {
+		std::ostringstream log;
+		log << "Tree as of " << window_since << ", the earlier history was omitted by cvscvt.\n";
+		std::string const l = log.str();
+		window_base = new Changeset(Lexer::add_symbol(reinterpret_cast<u1 const*>(l.data()), l.size()), Lexer::add_keyword("cvscvt"));
+		window_base->oldest = window_since;
+	}
+
+	uptr<CacheReader> cache_in;
+	uptr<CacheWriter> cache_out;
+	size_t            n_cached = 0;
+	if (cache_path) {
+		std::string const fingerprint = records_fingerprint("parse");
+		cache_in    = new CacheReader(cache_path, fingerprint);
+		cache_out   = new CacheWriter(cache_path, fingerprint);
+		save_parsed = true;
+	}
+
+	/* The state of an incremental conversion holds the head revision of each
+	 * RCS file by its path in the converted tree, so it survives the move of
+	 * a removed file into the Attic; the entry with the empty path holds the
+	 * mark counter and the mark of the last trunk commit. */
+	uptr<CacheReader> state_in;
+	uptr<CacheWriter> state_out;
+	size_t            n_unchanged = 0;
+	u4                mark        = 0;
+	u4                trunk_tip   = 0;
+	if (state_path) {
+		// A different trunk would not continue the history.
+		std::string const fingerprint = std::string("state2", 7) + trunk_name;
+		state_in  = new CacheReader(state_path, fingerprint);
+		state_out = new CacheWriter(state_path, fingerprint);
+
+		CacheKey  key;
+		u1 const* begin;
+		u1 const* end;
+		if (state_in->lookup("", key, begin, end)) {
+			RecordReader r(begin, end);
+			mark      = r.get<u4>();
+			trunk_tip = r.get<u4>();
+		} else if (access(state_path, F_OK) == 0) {
+			throw std::runtime_error("incremental state is unusable, e.g. written for another trunk");
+		}
+	}
+
+	if (n_shards != 0) parse_only = save_parsed = true;
 
-	u4 mark = 0;
+	// There is nothing to walk, when merging shards.
+	FTS* const fts = argc != 0 ? fts_open(argv, FTS_PHYSICAL | FTS_NOCHDIR, compar) : 0;
+	if (argc != 0 && !fts) throw std::runtime_error("fts_open failed");
 
 	Directory* const root = new Directory();
 
-	Indent     indent;
-	Directory* curdir = root;
-	while (FTSENT* const ent = fts_read(fts)) {
+	Phase                walk("walk");
+	Vector<ParseJob*>    jobs;
+	Vector<CacheReader*> shards;
+	if (!merge_paths.empty()) merge_shards(merge_paths, root, jobs, shards);
+
+	Indent            indent;
+	Directory*        curdir = root;
+	while (FTSENT* const ent = fts ? fts_read(fts) : 0) {
 		switch (ent->fts_info) {
 			case FTS_D: {
 				if (in_attic) {
@@ -1033,6 +3284,12 @@ done_opt:
 					in_attic = true;
 					continue;
 				}
+				if (!selected(curdir, ent->fts_name, true)) {
+					// fts returns the directory once more as FTS_DP.
+					fts_set(fts, ent, FTS_SKIP);
+					ent->fts_number = 1;
+					continue;
+				}
 				if (verbose) cerr << indent << ent->fts_name << "/\n";
 				++indent;
 				curdir = new Directory(ent->fts_name, curdir);
@@ -1041,6 +3298,7 @@ done_opt:
 
 			case FTS_DP:
 				if (ent->fts_name[0] == '\0') continue;
+				if (ent->fts_number != 0) continue; // Pruned
 				if (streq(ent->fts_name, ATTIC)) {
 					in_attic = false;
 					continue;
@@ -1055,240 +3313,217 @@ done_opt:
 					continue;
 				}
 
-				FILE* const file = fopen(ent->fts_accpath, "rb");
-				if (!file) throw std::runtime_error("open failed");
-
 				char* const suffix = &ent->fts_name[ent->fts_namelen - 2];
 				*suffix = '\0';
-				if (verbose) cerr << indent << ent->fts_name << endl;
-				File* const f = new File(ent->fts_name, curdir, is_executable(file));
+				bool const skip = !selected(curdir, ent->fts_name, false);
 				*suffix = ',';
-
-				++n_files;
-				read_file(file, f);
-				fclose(file);
-
-				FileRev* r = f->head;
-				switch (output_format) {
-					case OUT_GIT: {
-						PieceTable p(*r->text);
-						for (;;) {
-							if (r->state != STATE_DEAD) {
-								r->mark = ++mark;
-#ifdef DEBUG_EXPORT
-								cout << "# " << *f << ' ' << *r->rev << '\n';
-#endif
-								cout << "blob\n";
-								cout << "mark :" << mark << '\n';
-								cout << "data " << p.size() << '\n';
-								cout << p << '\n';
-							}
-							if (!(r = r->pred)) break;
-							p.modify(p, *r->text);
+				if (skip) continue;
+
+				RevNum const* converted_head = 0;
+				if (state_in.get()) {
+					std::ostringstream path;
+					*suffix = '\0';
+					static_cast<std::ostream&>(path) << *curdir << ent->fts_name;
+					*suffix = ',';
+
+					CacheKey  key;
+					u1 const* begin;
+					u1 const* end;
+					if (state_in->lookup(path.str().c_str(), key, begin, end)) {
+						if (key == CacheKey(*ent->fts_statp)) {
+							// Nothing new, so the file is not even parsed.
+							state_out->add(path.str().c_str(), key, begin, end - begin);
+							++n_unchanged;
+							continue;
 						}
-						break;
+						RecordReader r(begin, end);
+						u4 const major = r.get<u4>();
+						u4 const minor = r.get<u4>();
+						converted_head = revnums.find_or_insert(RevNum(0, major, minor));
 					}
+				}
 
-					case OUT_SVN: {
-						r->content.set(*r->text);
-						for (;;) {
-							PieceTable const& c = r->content;
-							if (!(r = r->pred)) break;
-							r->content.modify(c, *r->text);
-						}
-						break;
-					}
+				*suffix = '\0';
+				if (verbose) cerr << indent << ent->fts_name << endl;
+				File* const f = new File(ent->fts_name, curdir, is_executable(*ent->fts_statp));
+				*suffix = ',';
+
+				ParseJob* const job = new ParseJob(ent->fts_path, f, CacheKey(*ent->fts_statp), in_attic);
+				job->converted_head = converted_head;
+				if (cache_in.get() && cache_in->find(job->path, job->key, job->cached, job->cached_end)) {
+					++n_cached;
 				}
+				jobs.push_back(job);
 				break;
 			}
 		}
 	}
-	print_read_status() << '\n';
-
-	Vector<Changeset*> sets;
-	for (Set<Changeset*>::iterator i = changesets.begin(), end = changesets.end(); i != end; ++i) {
-		sets.push_back(*i);
-	}
 
-	std::sort(sets.begin(), sets.end(), older_changeset);
-
-	Vector<Changeset*> splitsets;
-	size_t k = 0;
-	for (Vector<Changeset*>::const_iterator i = sets.begin(), end = sets.end(); i != end; ++i) {
-		Changeset* const  c = *i;
-#if DEBUG_SPLIT
-		Date       const& o = c->oldest;
-		Date       const& n = c->newest;
-		cerr << endl << c << ' ' << o << ' ' << n << ' ' << *c->author << ' ' << c->filerevs.size() << (o != n ? " !!!" : "") << endl;
-		cerr << "---\n" << *c->log << "\n---\n";
-#endif
-
-		Vector<FileRev*>::iterator const rbegin = c->filerevs.begin();
-		Vector<FileRev*>::iterator const rend   = c->filerevs.end();
-
-		std::sort(rbegin, rend, older_filerev);
-		Set<File const*> contains;
-
-		bool need_split = false;
-		u4   last       = (*rbegin)->date.seconds();
-		for (Vector<FileRev*>::const_iterator i = rbegin; i != rend; ++i) {
-			FileRev& f   = **i;
-			u4 const now = f.date.seconds();
-			if (now - last > split_threshold) {
-				goto need_split;
-			} else if (contains.find(f.file)) {
-				if (f.pred && f.pred->changeset == f.changeset) {
-					need_split = true;
-#if DEBUG_SPLIT
-					cerr << "vvv fixup vvv\n";
-#else
-					break;
-#endif
+	walk.count("files", jobs.size());
+	walk.end();
+
+	if (n_shards != 0) {
+		CacheWriter  out_shard(STDOUT_FILENO, records_fingerprint("shard"));
+		RecordWriter w;
+		save_walk(w, jobs);
+		out_shard.add("", CacheKey(), w.data().data(), w.data().size());
+
+		size_t const n_walked = jobs.size();
+		select_shard(jobs, shard, n_shards);
+		Phase    read("read");
+		BusyTime busy;
+		{
+			ParseQueue queue(jobs, n_jobs - 1);
+			for (Vector<ParseJob*>::const_iterator i = jobs.begin(), end = jobs.end(); i != end; ++i) {
+				ParseJob& job = **i;
+				if (queue.steal(job)) {
+					job.parse.start();
+					parse_job(job);
+					job.parse.stop();
+					cerr << job.diag.str();
+					release_texts(job);
+					write_record(&out_shard, job);
 				} else {
-need_split:
-					need_split = true;
-#if DEBUG_SPLIT
-					contains.clear();
-					cerr << "--- split ---\n";
-#else
-					break;
-#endif
-					goto insert;
+					queue.wait(job);
+					cerr << job.diag.str();
+					if (!job.error.empty()) throw std::runtime_error(job.error);
+					queue.release(write_record(&out_shard, job));
 				}
-			} else {
-insert:
-				contains.insert(f.file);
+				busy.add(job);
 			}
-			last = now;
-#if DEBUG_SPLIT
-			cerr << "  " << f.date << ' ' << f.state << ' ' << *f.rev;
-			if (FileRev const* pred = f.pred)
-				cerr << " <- " << *pred->rev;
-			cerr << ' ' << *f.file << endl;
-#endif
 		}
+		out_shard.commit();
+		cerr << "shard: " << jobs.size() << " of " << n_walked << " files\n";
+		busy.count(read);
+		read.end();
+
+		for (Vector<ParseJob*>::const_iterator i = jobs.begin(), end = jobs.end(); i != end; ++i) {
+			delete *i;
+		}
+		fts_close(fts);
+		trace_finish();
+		return EXIT_SUCCESS;
+	}
+
+	rank_files(jobs);
+	Phase    read("read");
+	BusyTime busy;
+	{
+		ParseQueue queue(jobs, n_jobs - 1);
+		for (Vector<ParseJob*>::const_iterator i = jobs.begin(), end = jobs.end(); i != end; ++i) {
+			ParseJob& job = **i;
+			if (queue.steal(job)) {
+				job.parse.start();
+				parse_job(job);
+				job.parse.stop();
+				cerr << job.diag.str();
+				register_file(job);
+				write_record(cache_out.get(), job);
+				write_state(state_out.get(), job);
+
+				job.reconstruct.start();
+				switch (output_format) {
+					case OUT_GIT: {
+						WriteBlob w(mark);
+						reconstruct_blobs(job.file, w);
+						release_texts(job);
+						break;
+					}
 
-		if (need_split) {
-			u4         last   = (*rbegin)->date.seconds();
-			Changeset* newset = new Changeset(c->log, c->author);
-			contains.clear();
-			for (Vector<FileRev*>::const_iterator i = rbegin; i != rend; ++i) {
-				FileRev& f   = **i;
-				u4 const now = f.date.seconds();
-				if (now - last > split_threshold) {
-					goto do_split;
-				} else if (contains.find(f.file)) {
-					if (f.pred && f.pred->changeset == newset) {
-						f.pred = f.pred->pred;
-						cerr << CLEAR "note: treating " << *f.file << ' ' << *f.rev << " as fixup commit\n";
+					case OUT_SVN:
+						take_snapshots(job.file);
+						break;
+				}
+				job.reconstruct.stop();
+			} else {
+				queue.wait(job);
+				cerr << job.diag.str();
+				if (!job.error.empty()) throw std::runtime_error(job.error);
+				register_file(job);
+
+				write_state(state_out.get(), job);
+				size_t released = write_record(cache_out.get(), job);
+				if (output_format == OUT_GIT) {
+					if (job.stream) {
+						job.reconstruct.start();
+						WriteBlob w(mark);
+						reconstruct_blobs(job.file, w);
+						release_texts(job);
+						job.reconstruct.stop();
 					} else {
-do_split:
-						contains.clear();
-						splitsets.push_back(newset);
-						newset = new Changeset(c->log, c->author);
-						goto do_insert;
+						released += write_buffered_blobs(job, mark);
 					}
-				} else {
-do_insert:
-					contains.insert(f.file);
 				}
-				last = now;
-				newset->add(&f);
+				queue.release(released);
 			}
-			splitsets.push_back(newset);
-			delete c;
-		} else {
-			splitsets.push_back(c);
-		}
-
-		if (++k % 1000 == 0) {
-			cerr << CLEAR "splitting... " << k << " -> " << splitsets.size();
+			busy.add(job);
 		}
 	}
-	cerr << CLEAR "splitting... " << k << " -> " << splitsets.size() << '\n';
-
-	Vector<Changeset*>::const_iterator const begin = splitsets.begin();
-	Vector<Changeset*>::const_iterator const end   = splitsets.end();
-	for (Vector<Changeset*>::const_iterator i = begin; i != end; ++i) {
-		Changeset const& c = **i;
-
-		for (Vector<FileRev*>::const_iterator i = c.filerevs.begin(), end = c.filerevs.end(); i != end; ++i) {
-			FileRev const& f = **i;
-			assert(!f.pred || f.pred->changeset != f.changeset);
-			if (f.pred)
-				++f.pred->changeset->n_succ;
-		}
+	busy.count(read);
+	read.count("revisions", file_revs);
+	read.end();
+	for (Vector<ParseJob*>::const_iterator i = jobs.begin(), end = jobs.end(); i != end; ++i) {
+		delete *i;
 	}
-
-	Heap<Changeset*, bool(Changeset const*, Changeset const*)> roots(older_changeset);
-	for (Vector<Changeset*>::const_iterator i = begin; i != end; ++i) {
-		Changeset* const c = *i;
-		if (c->n_succ != 0) continue;
-		roots.push(c);
+	for (Vector<CacheReader*>::const_iterator i = shards.begin(), end = shards.end(); i != end; ++i) {
+		delete *i;
 	}
+	print_read_status() << '\n';
 
-	Vector<Changeset*> sorted_changesets;
-
-	{
-#if DEBUG_SPLIT
-		cerr << "\nsorted:\n";
-#endif
-		size_t n = 0;
-		while (!roots.empty()) {
-			Changeset& c = *roots.front();
-			roots.pop();
-
-			c.id = n;
-
-			sorted_changesets.push_back(&c);
-
-#if DEBUG_SPLIT
-			cerr << &c << ' ' << c.oldest << ' ' << c.newest << ' ' << *c.author << ' ' << c.filerevs.size() << endl;
-#endif
-
-			for (Vector<FileRev*>::const_iterator i = c.filerevs.begin(), end = c.filerevs.end(); i != end; ++i) {
-				FileRev const&       f    = **i;
-				FileRev const* const pred = f.pred;
-				if (!pred) continue;
-				Changeset* const predc = pred->changeset;
-				if (--predc->n_succ != 0) continue;
-				roots.push(predc);
-			}
-
-			if (++n % 1000 == 0) {
-				cerr << CLEAR "sorting... " << n;
-			}
-		}
-		cerr << CLEAR "sorting... " << n << '\n';
+	if (cache_out.get()) {
+		cache_out->commit();
+		cerr << "parse cache: " << n_cached << " of " << jobs.size() << " files up to date\n";
 	}
 
-#if DEBUG_SPLIT
-	{
-		bool good = true;
-		for (Vector<Changeset*>::const_iterator i = begin; i != end; ++i) {
-			Changeset const& c = **i;
-			if (c.n_succ == 0) continue;
-
-			if (good) cerr << "\nmissing:\n";
+	Phase              group("group");
+	Vector<Changeset*> sets;
+	join_buckets(sets);
 
-			cerr << &c << ' ' << c.oldest << ' ' << c.newest << ' ' << *c.author << " files: " << c.filerevs.size() << " succ: " << c.n_succ << '\n';
+	std::sort(sets.begin(), sets.end(), older_changeset);
+	group.count("changesets", sets.size());
+	group.end();
 
-			for (Vector<FileRev*>::const_iterator i = c.filerevs.begin(), end = c.filerevs.end(); i != end; ++i) {
-				FileRev const& r = **i;
-				cerr << "  " << *r.file << ' ' << *r.rev << '\n';
-			}
+	Phase              split("split");
+	Vector<Changeset*> splitsets;
+	split_changesets(sets, splitsets, DEBUG_SPLIT ? 0 : n_jobs - 1);
+	split.count("changesets", splitsets.size());
+	split.end();
 
-			good = false;
-		}
-		if (!good) return EXIT_FAILURE;
+	Phase              sort("sort");
+	Vector<Changeset*> sorted_changesets;
+	sort_changesets(splitsets, sorted_changesets);
+	sort.count("changesets", sorted_changesets.size());
+	sort.end();
+
+	// The base tree is emitted first; it has an id for the tags referring to it.
+	if (window_base) {
+		window_base->id = sorted_changesets.size();
+		if (!window_base->filerevs.empty()) sorted_changesets.push_back(window_base);
 	}
-#endif
 
+	Phase        resolve("tags");
 	Vector<Tag*> sorted_tags;
 	for (Set<Tag*>::iterator it = tags.begin(), endt = tags.end(); it != endt; ++it) {
 		Tag&              t  = **it;
 		Vector<FileRev*>& fr = t.filerevs;
 
+		size_t n_converted = 0;
+		bool   too_new     = false;
+		for (Vector<FileRev*>::const_iterator i = fr.begin(), end = fr.end(); i != end; ++i) {
+			FileRev const* const r = *i;
+			if (r->converted && !r->in_base) ++n_converted;
+			if (r->too_new) too_new = true;
+		}
+		// The tag was made after the window.
+		if (too_new) continue;
+		if (n_converted != 0) {
+			// The commits of the converted revisions are not known anymore.
+			if (n_converted != fr.size()) {
+				cerr << CLEAR "warning: tag " << *t.name << " refers to revisions before the emitted history; skipping\n";
+			}
+			continue;
+		}
+
 		Changeset const* l = 0;
 		for (Vector<FileRev*>::iterator i = fr.begin(); i != fr.end();) {
 			FileRev*& r = *i;
@@ -1315,260 +3550,52 @@ skip_filerev:
 		}
 	}
 	std::sort(sorted_tags.begin(), sorted_tags.end(), older_tag);
+	resolve.count("tags", sorted_tags.size());
+	resolve.end();
+
+	uptr<CheckpointWriter> checkpoint;
+	if (checkpoint_path) {
+		RecordWriter w;
+		save_snapshot(w, sorted_changesets, sorted_tags, mark, trunk_tip);
+		checkpoint = new CheckpointWriter(checkpoint_path, w.data());
+	}
 
 	{
-		Vector<size_t> n_dir_entries(Directory::n_dirs());
-
-		if (output_format == OUT_SVN) {
-			cout << "SVN-fs-dump-format-version: 2\n\n";
-
-			Date const& d = sorted_changesets.front()->oldest;
-			static u1 const log[] = "Standard project directories initialized by cvscvt.";
-			emit_svn_revision(1, d, 0, 0, log, sizeof(log) - 1);
-			cout <<
-				"Node-path: " << trunk_name << "\n"
-				"Node-kind: dir\n"
-				"Node-action: add\n"
-				"\n"
-				"Node-path: " << tags_name << "\n"
-				"Node-kind: dir\n"
-				"Node-action: add\n"
-				"\n";
-			n_dir_entries[root->id] = 1;
-		}
-
-		u4 const date1970 = Date(1970, 1, 1, 0, 0, 0).seconds();
-		size_t n_commits = 0;
-		size_t n_tags    = 0;
-
-		Vector<Tag*>::const_iterator             ti    = sorted_tags.begin();
-		Vector<Tag*>::const_iterator       const tend  = sorted_tags.end();
-		Changeset const*                         tnext = ti != tend ? (*ti)->latest : 0;
-		Vector<Changeset*>::const_iterator const begin = sorted_changesets.begin();
-		Vector<Changeset*>::const_iterator const end   = sorted_changesets.end();
-		for (Vector<Changeset*>::const_iterator i = end; i != begin;) {
-			Changeset& c = **--i;
-
-			/* Do not emit empty changesets.
-			 * Skip changesets, which only add files which are dead and were dead
-			 * before or did not exist. */
-			bool empty = true;
-			for (Vector<FileRev*>::const_iterator i = c.filerevs.begin(), end = c.filerevs.end(); i != end; ++i) {
-				FileRev const& r = **i;
-				if (r.state == STATE_DEAD && (!r.pred || r.pred->state == STATE_DEAD)) continue;
-				empty = false;
-				break;
-			}
-			if (empty) continue;
-
-			uptr<Blob> log(convert_log(*c.log));
-			switch (output_format) {
-				case OUT_GIT: {
-#ifdef DEBUG_EXPORT
-					cout << "# " << c.oldest << '\n';
-#endif
-					cout << "commit refs/heads/" << trunk_name << '\n';
-					cout << "mark :" << (c.mark = ++mark) << '\n';
-					cout << "committer " << *c.author << " <" << *c.author << "@" << email_domain << "> " << c.oldest.seconds() - date1970 << " +0000\n";
-					cout << "data " << log->size << '\n';
-					cout << *log << '\n';
-					for (Vector<FileRev*>::const_iterator i = c.filerevs.begin(), end = c.filerevs.end(); i != end; ++i) {
-						FileRev const& r = **i;
-						// Skip file revisions which get a fixup in the same changeset.
-						if (r.next && r.next->changeset == r.changeset) continue;
-
-						File const& f = *r.file;
-						if (r.state == STATE_DEAD) {
-							cout << "D " << f << '\n';
-						} else {
-							char const* const mode = f.executable ? "100755" : "100644";
-							cout << "M " << mode << " :" << r.mark << ' ' << f << '\n';
-						}
-					}
-					break;
-				}
-
-				case OUT_SVN: {
-					Blob const& a = *c.author;
-					Blob const& l = *log;
-					emit_svn_revision(c.mark = n_commits + n_tags + 2, c.oldest, a.data, a.size, l.data, l.size);
-
-					for (Vector<FileRev*>::const_iterator i = c.filerevs.begin(), end = c.filerevs.end(); i != end; ++i) {
-						FileRev const& r = **i;
-						// Skip file revisions which get a fixup in the same changeset.
-						if (r.next && r.next->changeset == r.changeset) continue;
-
-						File const& f         = *r.file;
-						bool const  cur_dead  = r.state == STATE_DEAD;
-						bool const  pred_dead = !r.pred || r.pred->state == STATE_DEAD;
-
-						if (pred_dead && !cur_dead) {
-							add_dir_entry(trunk_name, n_dir_entries, f.dir);
-						}
-
-						if (!cur_dead) {
-							cout << "Node-path: " << trunk_name << '/' << f << "\nNode-kind: file\n";
-							if (pred_dead) {
-								cout << "Node-action: add\n";
-							} else {
-								cout << "Node-action: change\n";
-							}
-
-							size_t const text_len = r.content.size();
-							size_t       prop_len = 0;
-
-							bool const x = f.executable;
-							if (x) prop_len += 26;
-
-							if (prop_len != 0) {
-								prop_len += 10; // PROPS-END
-								cout << "Prop-content-length: " << prop_len << '\n';
-							}
-							cout << "Text-content-length: " << text_len            << '\n';
-							cout << "Content-length: "      << prop_len + text_len << "\n\n";
-
-							if (prop_len != 0) {
-								if (x) {
-									cout << "K 14\nsvn:executable\nV 1\n*\n";
-								}
-
-								cout << "PROPS-END\n";
-							}
-
-							cout << r.content;
-						} else if (!pred_dead) {
-							cout << "Node-path: " << trunk_name << '/' << f << "\nNode-action: delete\n\n";
-							del_dir_entry(trunk_name, n_dir_entries, f.dir);
-						}
-					}
-
-					cout << '\n';
-					break;
-				}
-			}
-
-			while (&c == tnext) {
-				Tag&              t  = **ti;
-				Vector<FileRev*>& fr = t.filerevs;
-
-				std::sort(fr.begin(), fr.end(), tagged_rev_older);
-
-				switch (output_format) {
-					case OUT_GIT: {
-						cout << "commit refs/tags/" << *t.name << '\n';
-						cout << "committer cvscvt <cvscvt@invalid> " << tnext->oldest.seconds() - date1970 << " +0000\n";
-						cout << "data 9\n";
-						cout << "Make tag\n\n";
-
-						FileRev const* min = fr.front();
-						FileRev const* max = fr.front()->next;
-						for (Vector<FileRev*>::const_iterator i = fr.begin(), end = fr.end(); i != end; ++i) {
-							FileRev const* const r = *i;
-							if (max && max->changeset->id >= r->changeset->id) {
-								cout << "merge :" << min->changeset->mark << '\n';
-								goto set_max_git;
-							} else if (!max || (r->next && max->changeset->id < r->next->changeset->id)) {
-set_max_git:
-								max = r->next;
-							}
-							min = r;
-						}
-						cout << "merge :" << min->changeset->mark << '\n';
-
-						cout << "deleteall\n";
-
-						for (Vector<FileRev*>::const_iterator i = fr.begin(), end = fr.end(); i != end; ++i) {
-							FileRev const&       r    = **i;
-							File    const&       f    = *r.file;
-							char    const* const mode = f.executable ? "100755" : "100644";
-							cout << "M " << mode << " :" << r.mark << ' ' << f << '\n';
-						}
-						break;
-					}
-
-					case OUT_SVN: {
-						std::string tag_path(tags_name);
-						tag_path += '/';
-						tag_path.append(reinterpret_cast<char const*>(t.name->data), t.name->size);
-
-						static u1 const log[] = "Make tag\n";
-						emit_svn_revision(n_commits + n_tags + 3, tnext->oldest, 0, 0, log, sizeof(log) - 1);
-
-						FileRev const*                   min      = fr.front();
-						FileRev const*                   max      = fr.front()->next;
-						Vector<size_t>                   n_tag_dir_entries(Directory::n_dirs());
-						Vector<FileRev*>::const_iterator next_out = fr.begin();
-						for (Vector<FileRev*>::const_iterator i = next_out, end = fr.end();; ++i) {
-							if (i == end) {
-								size_t const out_mark = min->changeset->mark;
-								for (; next_out != i; ++next_out) {
-									FileRev const& outr = **next_out;
-									File    const& outf = *outr.file;
-
-									add_dir_entry(tag_path.c_str(), n_tag_dir_entries, outf.dir);
-
-									cout <<
-										"Node-path: " << tag_path << '/' << outf << "\n"
-										"Node-kind: file\n"
-										"Node-action: add\n"
-										"Node-copyfrom-rev: " << out_mark << "\n"
-										"Node-copyfrom-path: " << trunk_name << '/' << outf << "\n\n";
-								}
-								break;
-							}
-
-							FileRev const* const r = *i;
-							if (max && max->changeset->id >= r->changeset->id) {
-								size_t const out_mark = min->changeset->mark;
-								for (; next_out != i; ++next_out) {
-									FileRev const& outr = **next_out;
-									File    const& outf = *outr.file;
-
-									add_dir_entry(tag_path.c_str(), n_tag_dir_entries, outf.dir);
-
-									cout <<
-										"Node-path: " << tag_path << '/' << outf << "\n"
-										"Node-kind: file\n"
-										"Node-action: add\n"
-										"Node-copyfrom-rev: " << out_mark << "\n"
-										"Node-copyfrom-path: " << trunk_name << '/' << outf << "\n\n";
-								}
-								goto set_max_svn;
-							} else if (!max || (r->next && max->changeset->id < r->next->changeset->id)) {
-set_max_svn:
-								max = r->next;
-							}
-							min = r;
-						}
-						cout << "merge :" << min->changeset->mark << '\n';
-						break;
-					}
-				}
-
-				++n_tags;
-				tnext = ++ti != tend ? (*ti)->latest : 0;
-			}
+		Phase emit("emit");
+		emit_dump(sorted_changesets, sorted_tags, root, content_budget, mark, trunk_tip, checkpoint.get(), 0);
+		emit.count("changesets", sorted_changesets.size());
+	}
 
-			if (++n_commits % 100 == 0) cerr << CLEAR "emitting... " << n_commits << " commits, " << n_tags << " tags " << c.oldest;
-		}
-		cerr << CLEAR "emitting... " << n_commits << " commits, " << n_tags << " tags\n";
+	if (state_out.get()) {
+		RecordWriter w;
+		w.put<u4>(mark);
+		w.put<u4>(trunk_tip);
+		state_out->add("", CacheKey(), w.data().data(), w.data().size());
+		// Files not walked this time, e.g. excluded by -x, keep their state.
+		size_t const n_kept = state_in->copy_unused(*state_out);
+		state_out->commit();
+		cerr << "incremental: " << n_unchanged << " unchanged files skipped, " << n_kept << " files not walked kept\n";
+	}
 
-		if (output_format == OUT_GIT) {
-			cout << "done\n";
-		}
+	if (verbose) {
+		Arena::Stats const a = Arena::totals();
+		cerr << "arena: " << a.n_objects << " objects, " << (a.used >> 20) << " MiB used, " << (a.reserved >> 20) << " MiB reserved in " << a.n_blocks << " blocks\n";
 	}
 
-	fts_close(fts);
+	if (fts) fts_close(fts);
 
+	trace_finish();
 	return EXIT_SUCCESS;
 }
 catch (std::exception const& e)
 {
 	cerr << CLEAR "error: " << e.what() << endl;
+	finish_failed_trace();
 	return EXIT_FAILURE;
 }
 catch (...)
 {
 	cerr << CLEAR "error: caught unknown exception" << endl;
+	finish_failed_trace();
 	return EXIT_FAILURE;
 }
@@ -0,0 +1,37 @@
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+
+#include "mappedfile.h"
+
+MappedFile::MappedFile(char const* const path) : data_(0), size_(0)
+{
+	int const fd = open(path, O_RDONLY);
+	if (fd < 0) throw std::runtime_error("open failed");
+
+	if (fstat(fd, &stat_) != 0) {
+		close(fd);
+		throw std::runtime_error("fstat failed");
+	}
+
+	size_t const size = stat_.st_size;
+	if (size != 0) {
+		void* const p = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (p == MAP_FAILED) {
+			close(fd);
+			throw std::runtime_error("mmap failed");
+		}
+		madvise(p, size, MADV_SEQUENTIAL);
+		data_ = static_cast<u1*>(p);
+		size_ = size;
+	}
+
+	close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+	if (data_) munmap(data_, size_);
+}
@@ -0,0 +1,34 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "types.h"
+
+/* Read-only mapping of a whole file.  The mapping is advised for sequential
+ * access, so the kernel reads ahead aggressively and drops pages behind. */
+class MappedFile
+{
+public:
+	MappedFile(char const* path);
+
+	~MappedFile();
+
+	u1 const* begin() const { return data_; }
+	u1 const* end()   const { return data_ + size_; }
+
+	size_t size() const { return size_; }
+
+	struct stat const& stat() const { return stat_; }
+
+private:
+	u1*         data_;
+	size_t      size_;
+	struct stat stat_;
+
+	MappedFile(MappedFile const&);      // No copy
+	void operator =(MappedFile const&); // No assignment
+};
+
+#endif
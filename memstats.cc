@@ -0,0 +1,91 @@
+#include <sys/resource.h>
+
+#include <algorithm>
+
+#include "memstats.h"
+#include "mutex.h"
+#include "vector.h"
+
+__thread MemCount* mem_counts;
+
+/* Sets are counted during static initialization already, so the registry and
+ * the locks are constructed on first use. */
+static Mutex& blocks_lock()
+{
+	static Mutex m;
+	return m;
+}
+
+static Mutex& sums_lock()
+{
+	static Mutex m;
+	return m;
+}
+
+static Vector<MemCount*>& blocks()
+{
+	static Vector<MemCount*> b;
+	return b;
+}
+
+static long long sums[MEM_KINDS];
+static long long peaks[MEM_KINDS];
+
+MemCount* mem_register()
+{
+	// Never freed, the objects outlive the thread.
+	MemCount* const c = new MemCount[MEM_KINDS];
+	Lock l(blocks_lock());
+	blocks().push_back(c);
+	return mem_counts = c;
+}
+
+MemCount mem_total(MemKind const k)
+{
+	Lock     l(blocks_lock());
+	MemCount t;
+	for (Vector<MemCount*>::const_iterator i = blocks().begin(), end = blocks().end(); i != end; ++i) {
+		t.n_objects += (*i)[k].n_objects;
+		t.bytes     += (*i)[k].bytes;
+	}
+	return t;
+}
+
+void mem_flush(MemKind const k, long long const bytes)
+{
+	Lock l(sums_lock());
+	long long const sum = sums[k] += bytes;
+	if (peaks[k] < sum) peaks[k] = sum;
+}
+
+long long mem_peak(MemKind const k)
+{
+	long long const live = mem_total(k).bytes;
+	Lock l(sums_lock());
+	return std::max(peaks[k], live);
+}
+
+char const* mem_name(MemKind const k)
+{
+	static char const* const names[] = {
+		"symbols",
+		"texts",
+		"filerevs",
+		"changesets",
+		"tags",
+		"pieces",
+		"tables"
+	};
+	return names[k];
+}
+
+u8 peak_rss()
+{
+	struct rusage u;
+	if (getrusage(RUSAGE_SELF, &u) != 0) return 0;
+#ifdef __APPLE__
+	return u.ru_maxrss;
+#else
+	return (u8)u.ru_maxrss << 10;
+#endif
+}
@@ -0,0 +1,67 @@
+#ifndef MEMSTATS_H
+#define MEMSTATS_H
+
+#include "types.h"
+
+/* Live objects and bytes per kind of data, for the memory report of -p.
+ * Each thread counts into a block of its own, so counting needs no locking.
+ * The totals are exact, when the other threads are idle.
+ * For the high-water mark each thread adds its changes to a shared sum in
+ * steps of MEM_FLUSH bytes, so the peak may be missed by that much per
+ * thread. */
+enum MemKind
+{
+	MEM_SYMBOLS,    // Interned Blobs: logs, authors, revision numbers, ...
+	MEM_TEXTS,      // Deltatexts held by the FileRevs
+	MEM_FILEREVS,
+	MEM_CHANGESETS, // Including their vectors of revisions
+	MEM_TAGS,       // Including their vectors of revisions
+	MEM_PIECES,     // Pieces of PieceTables
+	MEM_TABLES,     // Hash tables of Sets
+	MEM_KINDS
+};
+
+struct MemCount
+{
+	MemCount() : n_objects(), bytes(), unflushed() {}
+
+	long long n_objects;
+	long long bytes;
+	long long unflushed; // Bytes not yet added to the shared sum
+};
+
+long long const MEM_FLUSH = 4096;
+
+extern __thread MemCount* mem_counts;
+
+// Gives the calling thread its block of counters.
+MemCount* mem_register();
+
+// Adds bytes to the shared sum and raises the high-water mark.
+void mem_flush(MemKind, long long bytes);
+
+static inline void mem_count(MemKind const k, long long const bytes, long long const n_objects)
+{
+	MemCount* c = mem_counts;
+	if (!c) c = mem_register();
+	c[k].n_objects += n_objects;
+	c[k].bytes     += bytes;
+	long long const u = c[k].unflushed += bytes;
+	if (u >= MEM_FLUSH || u <= -MEM_FLUSH) {
+		c[k].unflushed = 0;
+		mem_flush(k, u);
+	}
+}
+
+// Sum over all threads.
+MemCount mem_total(MemKind);
+
+// Most bytes live at once so far.
+long long mem_peak(MemKind);
+
+char const* mem_name(MemKind);
+
+// Largest resident set size of the process so far in bytes.
+u8 peak_rss();
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef MUTEX_H
+#define MUTEX_H
+
+#include <pthread.h>
+
+class Mutex
+{
+public:
+	Mutex()  { pthread_mutex_init(&m_, 0); }
+	~Mutex() { pthread_mutex_destroy(&m_); }
+
+	void lock()   { pthread_mutex_lock(&m_); }
+	void unlock() { pthread_mutex_unlock(&m_); }
+
+private:
+	pthread_mutex_t m_;
+
+	Mutex(Mutex const&);           // No copy
+	void operator =(Mutex const&); // No assignment
+
+	friend class Condition;
+};
+
+class Lock
+{
+public:
+	Lock(Mutex& m) : m_(m) { m_.lock(); }
+	~Lock() { m_.unlock(); }
+
+private:
+	Mutex& m_;
+
+	Lock(Lock const&);            // No copy
+	void operator =(Lock const&); // No assignment
+};
+
+class Condition
+{
+public:
+	Condition()  { pthread_cond_init(&c_, 0); }
+	~Condition() { pthread_cond_destroy(&c_); }
+
+	void wait(Mutex& m) { pthread_cond_wait(&c_, &m.m_); }
+
+	void broadcast() { pthread_cond_broadcast(&c_); }
+
+private:
+	pthread_cond_t c_;
+
+	Condition(Condition const&);       // No copy
+	void operator =(Condition const&); // No assignment
+};
+
+#endif
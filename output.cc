@@ -0,0 +1,63 @@
+#include <cerrno>
+#include <stdexcept>
+#include <unistd.h>
+
+#include "output.h"
+
+static void write_all(int const fd, char const* data, size_t size)
+{
+	while (size != 0) {
+		ssize_t const n = ::write(fd, data, size);
+		if (n < 0) {
+			if (errno == EINTR) continue;
+			throw std::runtime_error("write failed");
+		}
+		data += n;
+		size -= n;
+	}
+}
+
+Output::Output(int const fd) :
+	fd_(fd),
+	buf_(new char[BUFFER_SIZE]),
+	cur_(buf_),
+	end_(buf_ + BUFFER_SIZE)
+{}
+
+Output::~Output()
+{
+	delete[] buf_;
+}
+
+void Output::write(void const* const data, size_t const size)
+{
+	if (size > (size_t)(end_ - cur_)) {
+		flush();
+		if (size >= BUFFER_SIZE) {
+			// Large data is written directly instead of being copied first.
+			write_all(fd_, static_cast<char const*>(data), size);
+			return;
+		}
+	}
+	std::memcpy(cur_, data, size);
+	cur_ += size;
+}
+
+void Output::number(u8 v, unsigned const width)
+{
+	char  buf[20];
+	char* const end = buf + sizeof(buf);
+	char*       i   = end;
+	do {
+		*--i = '0' + v % 10;
+		v /= 10;
+	} while (v != 0);
+	while (i != buf && end - i < (ptrdiff_t)width) *--i = '0';
+	write(i, end - i);
+}
+
+void Output::flush()
+{
+	write_all(fd_, buf_, cur_ - buf_);
+	cur_ = buf_;
+}
@@ -0,0 +1,80 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <cstring>
+#include <string>
+
+#include "types.h"
+
+/* Buffered writer for the dump.  It writes to the file descriptor directly
+ * and formats numbers by hand, so no stream machinery is involved per
+ * insertion.  Buffered data is only written by flush(), not on destruction. */
+class Output
+{
+public:
+	explicit Output(int fd);
+
+	~Output();
+
+	void put(char const c)
+	{
+		if (cur_ == end_) flush();
+		*cur_++ = c;
+	}
+
+	void write(void const*, size_t);
+
+	// Decimal representation, padded with zeros to at least width digits.
+	void number(u8, unsigned width = 0);
+
+	void flush();
+
+private:
+	static size_t const BUFFER_SIZE = 1 << 20;
+
+	int   const fd_;
+	char* const buf_;
+	char*       cur_;
+	char* const end_;
+
+	Output(Output const&);          // No copy
+	void operator =(Output const&); // No assignment
+};
+
+static inline Output& operator <<(Output& o, char const c)
+{
+	o.put(c);
+	return o;
+}
+
+static inline Output& operator <<(Output& o, char const* const s)
+{
+	o.write(s, std::strlen(s));
+	return o;
+}
+
+static inline Output& operator <<(Output& o, std::string const& s)
+{
+	o.write(s.data(), s.size());
+	return o;
+}
+
+static inline Output& operator <<(Output& o, unsigned int const v)
+{
+	o.number(v);
+	return o;
+}
+
+static inline Output& operator <<(Output& o, unsigned long const v)
+{
+	o.number(v);
+	return o;
+}
+
+static inline Output& operator <<(Output& o, unsigned long long const v)
+{
+	o.number(v);
+	return o;
+}
+
+#endif
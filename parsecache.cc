@@ -0,0 +1,188 @@
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "parsecache.h"
+
+static char const magic[] = "cvscvt records 1\n";
+
+CacheKey::CacheKey(struct stat const& s) :
+	size(s.st_size),
+	mtime(s.st_mtime),
+#ifdef __APPLE__
+	mtime_nsec(s.st_mtimespec.tv_nsec)
+#else
+	mtime_nsec(s.st_mtim.tv_nsec)
+#endif
+{}
+
+struct CacheEntry
+{
+	CacheEntry(u1 const* const path, size_t const path_size) : path(path, path_size), key(), begin(), end(), used() {}
+
+	u4 hash() const { return path.hash(); }
+
+	BlobRef   path;
+	CacheKey  key;
+	u1 const* begin;
+	u1 const* end;
+	bool      used; // By lookup()
+};
+
+static inline bool operator ==(CacheEntry const& a, CacheEntry const& b)
+{
+	return a.path.size == b.path.size && memcmp(a.path.data, b.path.data, a.path.size) == 0;
+}
+
+static inline bool operator ==(CacheEntry const& a, BlobRef const& b)
+{
+	return a.path.size == b.size && memcmp(a.path.data, b.data, b.size) == 0;
+}
+
+CacheReader::CacheReader(char const* const path, std::string const& fingerprint)
+{
+	if (access(path, F_OK) != 0) return;
+
+	file_ = new MappedFile(path);
+
+	size_t const magic_size = sizeof(magic) - 1;
+	if (file_->size() < magic_size || memcmp(file_->begin(), magic, magic_size) != 0) return;
+
+	RecordReader r(file_->begin() + magic_size, file_->end());
+	try {
+		size_t          fp_size;
+		u1 const* const fp = r.get_bytes(fp_size);
+		if (!fp || fp_size != fingerprint.size() || memcmp(fp, fingerprint.data(), fp_size) != 0) return;
+
+		while (!r.done()) {
+			size_t          path_size;
+			u1 const* const path = r.get_bytes(path_size);
+			if (!path) throw std::runtime_error("corrupt parse cache");
+
+			CacheKey key;
+			key.size       = r.get<u8>();
+			key.mtime      = r.get<u8>();
+			key.mtime_nsec = r.get<u4>();
+
+			size_t          record_size;
+			u1 const* const record = r.get_bytes(record_size);
+			if (!record) throw std::runtime_error("corrupt parse cache");
+
+			CacheEntry* const e = new CacheEntry(path, path_size);
+			e->key   = key;
+			e->begin = record;
+			e->end   = record + record_size;
+			if (entries_.insert(e) != e) delete e;
+		}
+	} catch (std::exception const&) {
+		// A truncated cache still provides the complete entries before the damage.
+	}
+}
+
+CacheReader::~CacheReader()
+{
+	for (Set<CacheEntry*>::iterator i = entries_.begin(), end = entries_.end(); i != end; ++i) {
+		delete *i;
+	}
+}
+
+bool CacheReader::find(char const* const path, CacheKey const& key, u1 const*& begin, u1 const*& end)
+{
+	CacheKey  k;
+	u1 const* b;
+	u1 const* e;
+	if (!lookup(path, k, b, e) || !(k == key)) return false;
+	begin = b;
+	end   = e;
+	return true;
+}
+
+bool CacheReader::lookup(char const* const path, CacheKey& key, u1 const*& begin, u1 const*& end)
+{
+	CacheEntry* const* const e = entries_.find_key(BlobRef(reinterpret_cast<u1 const*>(path), strlen(path)));
+	if (!e) return false;
+	(*e)->used = true;
+	key   = (*e)->key;
+	begin = (*e)->begin;
+	end   = (*e)->end;
+	return true;
+}
+
+size_t CacheReader::copy_unused(CacheWriter& w)
+{
+	size_t n = 0;
+	for (Set<CacheEntry*>::iterator i = entries_.begin(), end = entries_.end(); i != end; ++i) {
+		CacheEntry const& e = **i;
+		if (e.used) continue;
+		std::string const path(reinterpret_cast<char const*>(e.path.data), e.path.size);
+		w.add(path.c_str(), e.key, e.begin, e.end - e.begin);
+		++n;
+	}
+	return n;
+}
+
+static int create(std::string const& path)
+{
+	int const fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	if (fd < 0) throw std::runtime_error("cannot create parse cache");
+	return fd;
+}
+
+CacheWriter::CacheWriter(char const* const path, std::string const& fingerprint) :
+	path_(path),
+	tmp_path_(path_ + ".tmp"),
+	fd_(create(tmp_path_)),
+	out_(fd_)
+{
+	start(fingerprint);
+}
+
+CacheWriter::CacheWriter(int const fd, std::string const& fingerprint) :
+	fd_(fd),
+	out_(fd_)
+{
+	start(fingerprint);
+}
+
+void CacheWriter::start(std::string const& fingerprint)
+{
+	RecordWriter w;
+	w.put_bytes(reinterpret_cast<u1 const*>(fingerprint.data()), fingerprint.size());
+	out_.write(magic, sizeof(magic) - 1);
+	out_.write(w.data().data(), w.data().size());
+}
+
+CacheWriter::~CacheWriter()
+{
+	if (fd_ < 0 || path_.empty()) return;
+	close(fd_);
+	unlink(tmp_path_.c_str());
+}
+
+void CacheWriter::add(char const* const path, CacheKey const& key, void const* const record, size_t const size)
+{
+	if (size >= RecordWriter::NONE) throw std::runtime_error("record too large for parse cache");
+
+	RecordWriter w;
+	w.put_bytes(reinterpret_cast<u1 const*>(path), strlen(path));
+	w.put<u8>(key.size);
+	w.put<u8>(key.mtime);
+	w.put<u4>(key.mtime_nsec);
+	w.put<u4>(size);
+	out_.write(w.data().data(), w.data().size());
+	out_.write(record, size);
+}
+
+void CacheWriter::commit()
+{
+	out_.flush();
+	if (path_.empty()) return;
+
+	int const fd = fd_;
+	fd_ = -1;
+	if (close(fd) != 0 || rename(tmp_path_.c_str(), path_.c_str()) != 0) {
+		unlink(tmp_path_.c_str());
+		throw std::runtime_error("cannot write parse cache");
+	}
+}
@@ -0,0 +1,171 @@
+#ifndef PARSECACHE_H
+#define PARSECACHE_H
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "blob.h"
+#include "mappedfile.h"
+#include "output.h"
+#include "set.h"
+#include "types.h"
+#include "uptr.h"
+
+/* A cache entry is only used, if the RCS file still has the same size and
+ * modification time. */
+struct CacheKey
+{
+	CacheKey() : size(), mtime(), mtime_nsec() {}
+
+	CacheKey(struct stat const&);
+
+	u8 size;
+	u8 mtime;
+	u4 mtime_nsec;
+};
+
+static inline bool operator ==(CacheKey const& a, CacheKey const& b)
+{
+	return a.size == b.size && a.mtime == b.mtime && a.mtime_nsec == b.mtime_nsec;
+}
+
+struct CacheEntry;
+
+class CacheWriter;
+
+/* Per RCS file records of an earlier run, i.e. the parse cache (-C) and the
+ * state of an incremental conversion (-I).  The file holds a header followed
+ * by one entry per RCS file.  The records are opaque here; like the rest of
+ * the file they are in native byte order, so a cache is only usable on the
+ * machine, which wrote it.  A file written with a different fingerprint,
+ * i.e. of another kind or with different options affecting the records, is
+ * ignored. */
+class CacheReader
+{
+public:
+	// A missing or unusable cache file is treated like an empty one.
+	CacheReader(char const* path, std::string const& fingerprint);
+
+	~CacheReader();
+
+	// Stores the record of the file in [begin, end), unless it is missing or stale.
+	bool find(char const* path, CacheKey const&, u1 const*& begin, u1 const*& end);
+
+	// Like find(), but also returns a stale record together with its key.
+	bool lookup(char const* path, CacheKey&, u1 const*& begin, u1 const*& end);
+
+	/* Adds the entries, which were never looked up, unchanged to w.  Returns
+	 * their number. */
+	size_t copy_unused(CacheWriter&);
+
+	size_t size() const { return entries_.size(); }
+
+private:
+	uptr<MappedFile>  file_;
+	Set<CacheEntry*>  entries_;
+
+	CacheReader(CacheReader const&);     // No copy
+	void operator =(CacheReader const&); // No assignment
+};
+
+/* Writes a new cache next to the old one.  It only replaces the old one, when
+ * commit() is called, so an aborted run leaves the old cache intact. */
+class CacheWriter
+{
+public:
+	CacheWriter(char const* path, std::string const& fingerprint);
+
+	// Writes to an open file, e.g. stdout; commit() only flushes.
+	CacheWriter(int fd, std::string const& fingerprint);
+
+	~CacheWriter();
+
+	void add(char const* path, CacheKey const&, void const* record, size_t size);
+
+	void commit();
+
+private:
+	void start(std::string const& fingerprint);
+
+	std::string const path_; // Empty, if writing to an open file
+	std::string const tmp_path_;
+	int               fd_;
+	Output            out_;
+
+	CacheWriter(CacheWriter const&);     // No copy
+	void operator =(CacheWriter const&); // No assignment
+};
+
+// Serializes values in native byte order.
+class RecordWriter
+{
+public:
+	template<typename T> void put(T const v)
+	{
+		data_.append(reinterpret_cast<char const*>(&v), sizeof(v));
+	}
+
+	// Byte string; null is distinct from the empty string.
+	void put_bytes(u1 const* const data, size_t const size)
+	{
+		if (size >= NONE) throw std::runtime_error("string too large for parse cache");
+		put<u4>(data ? size : NONE);
+		if (data) data_.append(reinterpret_cast<char const*>(data), size);
+	}
+
+	void put_blob(Blob const* const b)
+	{
+		b ? put_bytes(b->data, b->size) : put_bytes(0, 0);
+	}
+
+	std::string& data() { return data_; }
+
+	static u4 const NONE = 0xFFFFFFFFU;
+
+private:
+	std::string data_;
+};
+
+class RecordReader
+{
+public:
+	RecordReader(u1 const* const begin, u1 const* const end) : cur_(begin), end_(end) {}
+
+	template<typename T> T get()
+	{
+		need(sizeof(T));
+		T v;
+		std::memcpy(&v, cur_, sizeof(v));
+		cur_ += sizeof(v);
+		return v;
+	}
+
+	// Returns null for a null byte string.
+	u1 const* get_bytes(size_t& size)
+	{
+		u4 const n = get<u4>();
+		if (n == RecordWriter::NONE) return 0;
+		need(n);
+		u1 const* const data = cur_;
+		cur_ += n;
+		size  = n;
+		return data;
+	}
+
+	bool done() const { return cur_ == end_; }
+
+private:
+	void need(size_t const n)
+	{
+		if ((size_t)(end_ - cur_) < n) throw std::runtime_error("corrupt parse cache record");
+	}
+
+	u1 const*       cur_;
+	u1 const* const end_;
+};
+
+#endif
@@ -1,24 +1,35 @@
 #include <stdexcept>
 
 #include "piecetable.h"
+#include "scan.h"
+
+void PieceTable::count(size_t const old_pieces)
+{
+	size_t const bytes = pieces_.capacity() * sizeof(Piece);
+	mem_count(MEM_PIECES, (long long)bytes - (long long)counted_, (long long)pieces_.size() - (long long)old_pieces);
+	counted_ = bytes;
+}
 
 void PieceTable::set(Blob const& b)
 {
+	size_t const old_pieces = pieces_.size();
 	size_ = b.size;
 
-	u1 const* data = b.data;
-	size_t    size = 0;
-	for (u1 const* i = data, * const end = data + b.size; i != end; ++i) {
-		++size;
-		if (*i == '\n') {
-			pieces_.push_back(Piece(data, size));
-			data = i + 1;
-			size = 0;
+	u1 const*       data = b.data;
+	u1 const* const end  = data + b.size;
+	for (;;) {
+		u1 const*    ends[64];
+		size_t const n = split_lines(data, end, ends, 64);
+		for (size_t k = 0; k != n; ++k) {
+			pieces_.push_back(Piece(data, ends[k] - data));
+			data = ends[k];
 		}
+		if (n != 64) break;
 	}
-	if (size != 0) {
-		pieces_.push_back(Piece(data, size));
+	if (data != end) {
+		pieces_.push_back(Piece(data, end - data));
 	}
+	count(old_pieces);
 }
 
 void PieceTable::modify(PieceTable const& src, Blob const& b)
@@ -67,23 +78,24 @@ void PieceTable::modify(PieceTable const& src, Blob const& b)
 		}
 
 		if (cmd == 'a') {
-			u1 const* data = i;
-			size_t    size = 0;
-			for (;;) {
-				if (i == end) {
-					if (n != 1 || size == 0) goto invalid;
+			while (n != 0) {
+				u1 const*    ends[64];
+				size_t const want = n < 64 ? n : 64;
+				size_t const got  = split_lines(i, end, ends, want);
+				for (size_t k = 0; k != got; ++k) {
+					size_t const size = ends[k] - i;
 					total += size;
-					p.push_back(Piece(data, size));
-					break;
+					p.push_back(Piece(i, size));
+					i = ends[k];
 				}
-
-				++size;
-				if (*i++ == '\n') {
-					total += size;
-					p.push_back(Piece(data, size));
-					if (--n == 0) break;
-					data = i;
-					size = 0;
+				n -= got;
+				if (got != want) {
+					// Only the last line of the text may lack a newline.
+					if (n != 1 || i == end) goto invalid;
+					total += end - i;
+					p.push_back(Piece(i, end - i));
+					i = end;
+					break;
 				}
 			}
 		} else if (cmd == 'd') {
@@ -102,6 +114,7 @@ void PieceTable::modify(PieceTable const& src, Blob const& b)
 
 	std::swap(pieces_, p);
 	size_ = total;
+	count(p.size()); // p holds the old pieces now
 	return;
 
 invalid:
@@ -115,3 +128,11 @@ std::ostream& operator <<(std::ostream& o, PieceTable const& p)
 	}
 	return o;
 }
+
+Output& operator <<(Output& o, PieceTable const& p)
+{
+	for (Vector<PieceTable::Piece>::const_iterator i = p.pieces_.begin(), end = p.pieces_.end(); i != end; ++i) {
+		o.write(i->data, i->size);
+	}
+	return o;
+}
@@ -4,14 +4,17 @@
 #include <ostream>
 
 #include "blob.h"
+#include "memstats.h"
 #include "vector.h"
 
 class PieceTable
 {
 public:
-	PieceTable() : size_(0) {}
+	PieceTable() : size_(0), counted_(0) {}
 
-	PieceTable(Blob const& b) { set(b); }
+	PieceTable(Blob const& b) : counted_(0) { set(b); }
+
+	~PieceTable() { mem_count(MEM_PIECES, -(long long)counted_, -(long long)pieces_.size()); }
 
 	void set(Blob const&);
 
@@ -19,6 +22,24 @@ public:
 
 	size_t size() const { return size_; }
 
+	// Memory used by the pieces, not counting the text they refer to.
+	size_t footprint() const { return pieces_.size() * sizeof(Piece); }
+
+	// Passes the content piece by piece to s.write(data, size).
+	template<typename Sink> void write_to(Sink& s) const
+	{
+		for (typename Vector<Piece>::const_iterator i = pieces_.begin(), end = pieces_.end(); i != end; ++i) {
+			s.write(i->data, i->size);
+		}
+	}
+
+	void swap(PieceTable& o)
+	{
+		std::swap(pieces_,  o.pieces_);
+		std::swap(size_,    o.size_);
+		std::swap(counted_, o.counted_);
+	}
+
 private:
 	struct Piece
 	{
@@ -28,10 +49,15 @@ private:
 		size_t    size;
 	};
 
+	// Updates the memory report after the pieces changed.
+	void count(size_t old_pieces);
+
 	Vector<Piece> pieces_;
 	size_t        size_;
+	size_t        counted_; // Bytes of pieces_ in the memory report
 
 	friend std::ostream& operator <<(std::ostream&, PieceTable const&);
+	friend Output&       operator <<(Output&,       PieceTable const&);
 };
 
 #endif
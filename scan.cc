@@ -0,0 +1,113 @@
+#include "scan.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#	include <immintrin.h>
+#	define SCAN_X86 1
+#else
+#	define SCAN_X86 0
+#endif
+
+static u1 const* find_byte_scalar(u1 const* i, u1 const* const end, u1 const c)
+{
+	while (i != end && *i != c) ++i;
+	return i;
+}
+
+static size_t split_lines_scalar(u1 const* i, u1 const* const end, u1 const** const ends, size_t const max)
+{
+	size_t n = 0;
+	while (n != max && i != end) {
+		if (*i++ == '\n') ends[n++] = i;
+	}
+	return n;
+}
+
+static ScanKernel const kernel_scalar = { "scalar", find_byte_scalar, split_lines_scalar };
+
+#if SCAN_X86
+/* The vector kernels compare a whole block against the byte and then walk
+ * the set bits of the resulting mask.  The remainder is left to the scalar
+ * kernels. */
+
+__attribute__((target("sse2")))
+static u1 const* find_byte_sse2(u1 const* i, u1 const* const end, u1 const c)
+{
+	__m128i const needle = _mm_set1_epi8(c);
+	for (; end - i >= 16; i += 16) {
+		__m128i  const block = _mm_loadu_si128(reinterpret_cast<__m128i const*>(i));
+		unsigned const mask  = _mm_movemask_epi8(_mm_cmpeq_epi8(block, needle));
+		if (mask != 0) return i + __builtin_ctz(mask);
+	}
+	return find_byte_scalar(i, end, c);
+}
+
+__attribute__((target("sse2")))
+static size_t split_lines_sse2(u1 const* i, u1 const* const end, u1 const** const ends, size_t const max)
+{
+	__m128i const nl = _mm_set1_epi8('\n');
+	size_t        n  = 0;
+	for (; end - i >= 16; i += 16) {
+		__m128i const block = _mm_loadu_si128(reinterpret_cast<__m128i const*>(i));
+		for (unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, nl)); mask != 0; mask &= mask - 1) {
+			if (n == max) return n;
+			ends[n++] = i + __builtin_ctz(mask) + 1;
+		}
+	}
+	return n + split_lines_scalar(i, end, ends + n, max - n);
+}
+
+static ScanKernel const kernel_sse2 = { "sse2", find_byte_sse2, split_lines_sse2 };
+
+__attribute__((target("avx2")))
+static u1 const* find_byte_avx2(u1 const* i, u1 const* const end, u1 const c)
+{
+	__m256i const needle = _mm256_set1_epi8(c);
+	for (; end - i >= 32; i += 32) {
+		__m256i  const block = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(i));
+		unsigned const mask  = _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, needle));
+		if (mask != 0) return i + __builtin_ctz(mask);
+	}
+	return find_byte_sse2(i, end, c);
+}
+
+__attribute__((target("avx2")))
+static size_t split_lines_avx2(u1 const* i, u1 const* const end, u1 const** const ends, size_t const max)
+{
+	__m256i const nl = _mm256_set1_epi8('\n');
+	size_t        n  = 0;
+	for (; end - i >= 32; i += 32) {
+		__m256i const block = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(i));
+		for (unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, nl)); mask != 0; mask &= mask - 1) {
+			if (n == max) return n;
+			ends[n++] = i + __builtin_ctz(mask) + 1;
+		}
+	}
+	return n + split_lines_sse2(i, end, ends + n, max - n);
+}
+
+static ScanKernel const kernel_avx2 = { "avx2", find_byte_avx2, split_lines_avx2 };
+#endif
+
+static ScanKernel const* const* select_kernels()
+{
+	static ScanKernel const* kernels[4];
+	size_t n = 0;
+	kernels[n++] = &kernel_scalar;
+#if SCAN_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse2")) kernels[n++] = &kernel_sse2;
+	if (__builtin_cpu_supports("avx2")) kernels[n++] = &kernel_avx2;
+#endif
+	kernels[n] = 0;
+	return kernels;
+}
+
+static ScanKernel const* best_kernel(ScanKernel const* const* const kernels)
+{
+	ScanKernel const* const* i = kernels;
+	while (i[1]) ++i;
+	return *i;
+}
+
+ScanKernel const* const* const scan_kernels = select_kernels();
+ScanKernel const*        const scan         = best_kernel(scan_kernels);
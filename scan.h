@@ -0,0 +1,36 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include "types.h"
+
+/* Byte scanning kernels for the hot loops over deltatexts.  Several variants
+ * are compiled in; the best one supported by the CPU is chosen at startup. */
+struct ScanKernel
+{
+	char const* name;
+
+	// Returns the first c in [begin, end) or end.
+	u1 const* (*find_byte)(u1 const* begin, u1 const* end, u1 c);
+
+	/* Stores the end (one past the '\n') of each of the next at most max lines
+	 * in [begin, end) into ends and returns their number.  If the result is
+	 * max, there may be more lines starting at ends[max - 1]. */
+	size_t (*split_lines)(u1 const* begin, u1 const* end, u1 const** ends, size_t max);
+};
+
+// The kernels usable on this CPU, slowest first.  Terminated by a null pointer.
+extern ScanKernel const* const* const scan_kernels;
+
+extern ScanKernel const* const scan;
+
+static inline u1 const* find_byte(u1 const* const begin, u1 const* const end, u1 const c)
+{
+	return scan->find_byte(begin, end, c);
+}
+
+static inline size_t split_lines(u1 const* const begin, u1 const* const end, u1 const** const ends, size_t const max)
+{
+	return scan->split_lines(begin, end, ends, max);
+}
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef SET_H
 #define SET_H
 
+#include "memstats.h"
 #include "types.h"
 
 template<typename T> class Set
@@ -36,9 +37,16 @@ public:
 		Entry const* const end;
 	};
 
-	Set() : capacity_(256), size_(0), table_(new Entry[capacity_]()) {}
+	Set() : capacity_(256), size_(0), table_(new Entry[capacity_]())
+	{
+		mem_count(MEM_TABLES, capacity_ * sizeof(Entry), 1);
+	}
 
-	~Set() { delete [] table_; }
+	~Set()
+	{
+		mem_count(MEM_TABLES, -(long long)(capacity_ * sizeof(Entry)), -1);
+		delete [] table_;
+	}
 
 	void clear()
 	{
@@ -54,6 +62,8 @@ public:
 
 	T* find(T const&);
 
+	template<typename K> T* find_key(K const&);
+
 	iterator begin()
 	{
 		iterator i(table_, table_ + capacity_);
@@ -91,6 +101,7 @@ template<typename T> T& Set<T>::insert(T const& v)
 		}
 
 		delete [] table_;
+		mem_count(MEM_TABLES, (cap - capacity_) * sizeof(Entry), 0);
 		capacity_ = cap;
 		table_    = t;
 	}
@@ -123,4 +134,17 @@ template<typename T> T* Set<T>::find(T const& v)
 	}
 }
 
+template<typename T> template<typename K> T* Set<T>::find_key(K const& k)
+{
+	u4 const hash = k.hash();
+	for (u4 idx = hash, step = 0;; idx += ++step) {
+		Entry& e = table_[idx & (capacity_ - 1)];
+		if (!e.data) {
+			return 0;
+		} else if (e.hash == hash && *e.data == k) {
+			return &e.data;
+		}
+	}
+}
+
 #endif
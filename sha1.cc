@@ -0,0 +1,107 @@
+#include <cstring>
+
+#include "sha1.h"
+
+static inline u4 rol(u4 const x, unsigned const n)
+{
+	return x << n | x >> (32 - n);
+}
+
+static inline u4 load_be(u1 const* const p)
+{
+	return (u4)p[0] << 24 | (u4)p[1] << 16 | (u4)p[2] << 8 | p[3];
+}
+
+Sha1::Sha1() : len_(0)
+{
+	h_[0] = 0x67452301;
+	h_[1] = 0xEFCDAB89;
+	h_[2] = 0x98BADCFE;
+	h_[3] = 0x10325476;
+	h_[4] = 0xC3D2E1F0;
+}
+
+void Sha1::block(u1 const* const p)
+{
+	u4 w[80];
+	for (size_t i = 0; i != 16; ++i) w[i] = load_be(p + 4 * i);
+	for (size_t i = 16; i != 80; ++i) w[i] = rol(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+	u4 a = h_[0];
+	u4 b = h_[1];
+	u4 c = h_[2];
+	u4 d = h_[3];
+	u4 e = h_[4];
+	for (size_t i = 0; i != 80; ++i) {
+		u4 f;
+		u4 k;
+		if (i < 20) {
+			f = (b & c) | (~b & d);
+			k = 0x5A827999;
+		} else if (i < 40) {
+			f = b ^ c ^ d;
+			k = 0x6ED9EBA1;
+		} else if (i < 60) {
+			f = (b & c) | (b & d) | (c & d);
+			k = 0x8F1BBCDC;
+		} else {
+			f = b ^ c ^ d;
+			k = 0xCA62C1D6;
+		}
+		u4 const t = rol(a, 5) + f + e + k + w[i];
+		e = d;
+		d = c;
+		c = rol(b, 30);
+		b = a;
+		a = t;
+	}
+
+	h_[0] += a;
+	h_[1] += b;
+	h_[2] += c;
+	h_[3] += d;
+	h_[4] += e;
+}
+
+void Sha1::write(void const* const data, size_t size)
+{
+	u1 const* p    = static_cast<u1 const*>(data);
+	size_t    used = len_ % 64;
+	len_ += size;
+
+	if (used != 0) {
+		size_t const n = size < 64 - used ? size : 64 - used;
+		std::memcpy(buf_ + used, p, n);
+		p    += n;
+		size -= n;
+		used += n;
+		if (used != 64) return;
+		block(buf_);
+	}
+
+	for (; size >= 64; p += 64, size -= 64) {
+		block(p);
+	}
+	std::memcpy(buf_, p, size);
+}
+
+Digest Sha1::digest()
+{
+	u8     const bits    = len_ * 8;
+	size_t const used    = len_ % 64;
+	size_t const n       = used < 56 ? 56 - used : 120 - used; // At most 64
+	u1           pad[72] = { 0x80 };
+	for (size_t i = 0; i != 8; ++i) {
+		pad[n + i] = bits >> (56 - 8 * i);
+	}
+	write(pad, n + 8);
+
+	Digest d;
+	for (size_t i = 0; i != 5; ++i) {
+		d.bytes[4 * i + 0] = h_[i] >> 24;
+		d.bytes[4 * i + 1] = h_[i] >> 16;
+		d.bytes[4 * i + 2] = h_[i] >>  8;
+		d.bytes[4 * i + 3] = h_[i];
+	}
+	return d;
+}
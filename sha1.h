@@ -0,0 +1,40 @@
+#ifndef SHA1_H
+#define SHA1_H
+
+#include "types.h"
+
+struct Digest
+{
+	u1 bytes[20];
+
+	u4 hash() const { return bytes[0] | bytes[1] << 8 | bytes[2] << 16 | (u4)bytes[3] << 24; }
+};
+
+static inline bool operator ==(Digest const& a, Digest const& b)
+{
+	for (size_t i = 0; i != sizeof(a.bytes); ++i) {
+		if (a.bytes[i] != b.bytes[i]) return false;
+	}
+	return true;
+}
+
+/* SHA-1 over data passed to write() in any number of parts, so it can be fed
+ * like an Output. */
+class Sha1
+{
+public:
+	Sha1();
+
+	void write(void const*, size_t);
+
+	Digest digest();
+
+private:
+	void block(u1 const*);
+
+	u4 h_[5];
+	u1 buf_[64];
+	u8 len_;
+};
+
+#endif
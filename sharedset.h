@@ -0,0 +1,59 @@
+#ifndef SHAREDSET_H
+#define SHAREDSET_H
+
+#include "mutex.h"
+#include "set.h"
+#include "types.h"
+
+/* Set, which may be used by several threads at once.  The elements are
+ * distributed over independently locked shards by the upper bits of their
+ * hash multiplied by a large odd constant, so small hashes, e.g. of revision
+ * numbers, are spread, too; the lower bits of the plain hash select the slot
+ * inside the shard.  An element is only ever stored in one shard, so pointer
+ * equality of the returned elements still means equality of their values. */
+template<typename T> class SharedSet
+{
+public:
+	T insert(T const& v)
+	{
+		Shard& s = shard(v->hash());
+		Lock l(s.mutex);
+		return s.set.insert(v);
+	}
+
+	/* Returns the element equal to the key.  If there is none, k.create() is
+	 * inserted, so nothing is allocated for keys already present. */
+	template<typename K> T find_or_insert(K const& k)
+	{
+		Shard& s = shard(k.hash());
+		Lock l(s.mutex);
+		if (T const* const e = s.set.find_key(k)) return *e;
+		return s.set.insert(k.create());
+	}
+
+	size_t size()
+	{
+		size_t n = 0;
+		for (Shard* i = shards_; i != shards_ + N_SHARDS; ++i) {
+			Lock l(i->mutex);
+			n += i->set.size();
+		}
+		return n;
+	}
+
+private:
+	static unsigned const SHARD_BITS = 6;
+	static unsigned const N_SHARDS   = 1U << SHARD_BITS;
+
+	struct Shard
+	{
+		Mutex  mutex;
+		Set<T> set;
+	} __attribute__((aligned(64))); // Keep shards on separate cache lines.
+
+	Shard& shard(u4 const hash) { return shards_[(u4)(hash * 0x9E3779B1U) >> (32 - SHARD_BITS)]; }
+
+	Shard shards_[N_SHARDS];
+};
+
+#endif
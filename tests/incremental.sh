@@ -0,0 +1,77 @@
+#! /bin/sh
+# Incremental conversion (-I) across runs, which remove a file or do not walk
+# all files.  Usage: incremental.sh path/to/cvscvt
+set -e -u
+
+CVSCVT="$1"
+T="$(mktemp -d)"
+trap 'rm -fr "$T"' EXIT
+
+fail()
+{
+	echo "FAIL: $*"
+	exit 1
+}
+
+# count pattern file
+count()
+{
+	grep -c "$1" "$2" || true
+}
+
+# rcsfile path head revisions... where a revision is num:date:state:text
+rcsfile()
+{
+	f="$1"
+	head="$2"
+	shift 2
+	{
+		printf 'head\t%s;\naccess;\nsymbols\n\tREL_3:1.1;\nlocks; strict;\ncomment\t@# @;\n\n' "$head"
+		for r in "$@"; do
+			IFS=: read -r num date state text <<-END
+			$r
+			END
+			next="${num%.*}.$((${num##*.} - 1))"
+			[ "${num##*.}" = 1 ] && next=
+			printf '\n%s\ndate\t%s;\tauthor a;\tstate %s;\nbranches;\nnext\t%s;\n' "$num" "$date" "$state" "$next"
+		done
+		printf '\n\ndesc\n@@\n'
+		for r in "$@"; do
+			IFS=: read -r num date state text <<-END
+			$r
+			END
+			printf '\n\n%s\nlog\n@change %s\n@\ntext\n@%b@\n' "$num" "$num" "$text"
+		done
+	} > "$f"
+}
+
+mkdir -p "$T/cvs/dir"
+rcsfile "$T/cvs/dir/f.c,v" 1.2 \
+	'1.2:2001.01.02.00.00.00:Exp:two\n' \
+	'1.1:2001.01.01.00.00.00:Exp:d1 1\na1 1\none\n'
+rcsfile "$T/cvs/dir/g.c,v" 1.1 \
+	'1.1:2001.01.01.00.00.00:Exp:one\n'
+
+"$CVSCVT" -I "$T/state" "$T/cvs" > "$T/run1" 2> /dev/null
+[ "$(count '^commit refs/heads/' "$T/run1")" = 2 ] || fail "first run does not emit both commits"
+
+# cvs remove: a dead revision is added and the file moves into the Attic.
+mkdir "$T/cvs/dir/Attic"
+rm "$T/cvs/dir/f.c,v"
+rcsfile "$T/cvs/dir/Attic/f.c,v" 1.3 \
+	'1.3:2001.01.03.00.00.00:dead:two\n' \
+	'1.2:2001.01.02.00.00.00:Exp:' \
+	'1.1:2001.01.01.00.00.00:Exp:d1 1\na1 1\none\n'
+
+"$CVSCVT" -I "$T/state" "$T/cvs" > "$T/run2" 2> /dev/null
+[ "$(count '^commit refs/heads/' "$T/run2")" = 1 ] || fail "removal is not emitted as exactly one commit"
+[ "$(count '^D cvs/dir/f.c$' "$T/run2")" = 1 ] || fail "removal does not delete the file"
+[ "$(count '^M ' "$T/run2")" = 0 ] || fail "removal emits file contents again"
+[ "$(count 'refs/tags/' "$T/run2")" = 0 ] || fail "removal rewrites a tag"
+
+# Files excluded from a run keep their state for the next one.
+"$CVSCVT" -I "$T/state" -x g.c "$T/cvs" > "$T/run3" 2> /dev/null
+"$CVSCVT" -I "$T/state" "$T/cvs" > "$T/run4" 2> /dev/null
+[ "$(count '^commit refs/heads/' "$T/run4")" = 0 ] || fail "file not walked by the previous run is converted again"
+
+echo "PASS: incremental"
@@ -0,0 +1,130 @@
+#include "strutil.h"
+#include "text.h"
+
+// Removing keyword values never makes the text longer, so src's size suffices.
+Blob* unexpand(Blob const* const src, Vector<char const*> const& keywords)
+{
+	Blob* const dst = Blob::alloc(src->size);
+	for (u1 const* si = src->begin(), * const send = src->end(); si != send;) {
+		dst->append(*si);
+
+		if (*si++ == '$') {
+			u1 const* sk = si;
+
+			for (;; ++sk) {
+				if (sk == send) goto no_keyword;
+				u1 const c = *sk;
+				if (!between('A', c, 'Z') && !between('a', c, 'z')) break;
+			}
+
+			u1 const* const colon = sk;
+			if (sk == send || *sk++ != ':') goto no_keyword;
+
+			do {
+				if (sk == send) goto no_keyword;
+				if (*sk == '\n') goto no_keyword;
+			} while (*sk++ != '$');
+
+			for (Vector<char const*>::const_iterator vi = keywords.begin(), vend = keywords.end(); vi != vend; ++vi) {
+				u1   const* sm = si;
+				char const* k  = *vi;
+				for (; *sm == (u1)*k; ++sm, ++k) {}
+
+				if (*k == '\0' && sm == colon) {
+					while (si != colon) {
+						dst->append(*si++);
+					}
+					dst->append('$');
+					si = sk;
+					break;
+				}
+			}
+		}
+no_keyword:;
+	}
+	return dst;
+}
+
+static bool is_cont_byte(u1 const c)
+{
+	return 0x80 <= c && c < 0xC0;
+}
+
+Blob* convert_log(Blob const& src)
+{
+	BlobBuilder     b;
+	u1 const*       i      = src.begin();
+	u1 const* const end    = src.end();
+	u1 const*       lstart = i;
+	u1 const*       lend   = i;
+	bool            empty  = false;
+	for (;;) {
+		if (i == end) goto end;
+		switch (*i++) {
+			case '\t':
+			case ' ':
+				break;
+
+			case '\r':
+				if (i != end && *i == '\n') ++i;
+				/* FALLTHROUGH */
+			case '\n':
+				// TODO support other encodings besides utf-8/l1 hybrid
+end:
+				if (lstart == lend) {
+					empty = true;
+				} else {
+					if (empty) {
+						empty = false;
+						if (!b.empty()) b.add_byte('\n');
+					}
+					for (u1 const* k = lstart; k != lend;) {
+						u1 const c = *k;
+						if (c < 0x80) {
+							b.add_byte(c);
+							k += 1;
+						} else if (c < 0xC2) {
+							goto convert_byte;
+						} else if (c < 0xE0) {
+							if (lend - k < 2)        goto convert_byte;
+							if (!is_cont_byte(k[1])) goto convert_byte;
+							b.add_byte(c);
+							b.add_byte(k[1]);
+							k += 2;
+						} else if (c < 0xF0) {
+							if (lend - k < 3)        goto convert_byte;
+							if (!is_cont_byte(k[1])) goto convert_byte;
+							if (!is_cont_byte(k[2])) goto convert_byte;
+							b.add_byte(c);
+							b.add_byte(k[1]);
+							b.add_byte(k[2]);
+							k += 3;
+						} else if (c < 0xF1) {
+							if (lend - k < 4)        goto convert_byte;
+							if (!is_cont_byte(k[1])) goto convert_byte;
+							if (!is_cont_byte(k[2])) goto convert_byte;
+							if (!is_cont_byte(k[3])) goto convert_byte;
+							b.add_byte(c);
+							b.add_byte(k[1]);
+							b.add_byte(k[2]);
+							b.add_byte(k[3]);
+							k += 4;
+						} else {
+convert_byte:
+							b.add_byte(0xC0 | c >> 6);
+							b.add_byte(0x80 | (c & 0x3F));
+							k += 1;
+						}
+					}
+					b.add_byte('\n');
+				}
+				if (i == end) return b.get();
+				lstart = lend = i;
+				break;
+
+			default:
+				lend = i;
+				break;
+		}
+	}
+}
@@ -0,0 +1,16 @@
+#ifndef TEXT_H
+#define TEXT_H
+
+#include "blob.h"
+#include "vector.h"
+
+/* Collapses the values of the given keywords, e.g. "$Id: f,v 1.1 ...$" becomes
+ * "$Id$".  The caller owns the returned Blob. */
+Blob* unexpand(Blob const* src, Vector<char const*> const& keywords);
+
+/* Turns a log message into a commit message: Trailing whitespace and empty
+ * lines at the ends are dropped, runs of empty lines become one and bytes,
+ * which are not UTF-8, are taken as Latin-1. */
+Blob* convert_log(Blob const& src);
+
+#endif
@@ -0,0 +1,233 @@
+#include <fcntl.h>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <time.h>
+#include <unistd.h>
+
+#include "memstats.h"
+#include "mutex.h"
+#include "output.h"
+#include "trace.h"
+#include "vector.h"
+
+struct Event
+{
+	Event(char const* const name, char const* const cat, char const type, double const begin, double const wall, u4 const thread, std::string const& args) :
+		name(name),
+		cat(cat),
+		type(type),
+		begin(begin),
+		wall(wall),
+		thread(thread),
+		args(args)
+	{}
+
+	char const* const name;
+	char const* const cat;
+	char        const type; // 'X' for a span of time, 'C' for a sample of counters
+	double      const begin;
+	double      const wall;
+	u4          const thread;
+	std::string const args; // JSON members without braces
+};
+
+static double seconds(clockid_t const clock)
+{
+	struct timespec t;
+	clock_gettime(clock, &t);
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+double wall_time()
+{
+	return seconds(CLOCK_MONOTONIC);
+}
+
+double cpu_time()
+{
+	return seconds(CLOCK_PROCESS_CPUTIME_ID);
+}
+
+static Mutex        threads_lock;
+static u4           n_threads;
+static __thread u4  thread_id;
+
+static u4 current_thread()
+{
+	if (thread_id == 0) {
+		Lock l(threads_lock);
+		thread_id = ++n_threads;
+	}
+	return thread_id;
+}
+
+// Initialized by the main thread, so it is thread 1.
+static u4     const main_thread = current_thread();
+static double const run_start   = wall_time();
+
+static bool               print_stats;
+static char const*        trace_path;
+static Vector<Event*>     events;
+
+void Span::start()
+{
+	thread = current_thread();
+	begin  = wall_time();
+}
+
+Phase::Phase(char const* const name) :
+	name_(name),
+	wall_(wall_time()),
+	cpu_(cpu_time()),
+	ended_(false),
+	n_counts_(0)
+{}
+
+void Phase::add(char const* const unit, double const n, int const decimals, bool const rate)
+{
+	if (n_counts_ == MAX_COUNTS) return;
+	Count& c = counts_[n_counts_++];
+	c.unit     = unit;
+	c.n        = n;
+	c.decimals = decimals;
+	c.rate     = rate;
+}
+
+void Phase::count(char const* const unit, double const n)
+{
+	add(unit, n, 0, true);
+}
+
+void Phase::bytes(double const n)
+{
+	add("MB", n / 1e6, 1, true);
+}
+
+void Phase::busy(char const* const what, double const seconds)
+{
+	add(what, seconds, 2, false);
+}
+
+// Overwrites the progress line on stderr.
+static void print(std::ostringstream const& line)
+{
+	if (print_stats) std::cerr << "\r\x1B[K" << line.str() << std::flush;
+}
+
+void Phase::end()
+{
+	if (ended_) return;
+	ended_ = true;
+	if (!print_stats && !trace_path) return;
+
+	double const wall = wall_time() - wall_;
+	double const cpu  = cpu_time()  - cpu_;
+
+	// Printed right away, so a run failing or killed later still shows where
+	// the time and memory went.
+	std::ostringstream line;
+	line << std::fixed << std::setprecision(2) << std::setw(12) << std::left << name_ << std::right << std::setw(8) << wall << " s wall " << std::setw(8) << cpu << " s cpu";
+	std::ostringstream args;
+	args << std::fixed << std::setprecision(3) << "\"cpu_s\": " << cpu;
+	for (Count const* c = counts_, * const end = counts_ + n_counts_; c != end; ++c) {
+		if (c->rate) {
+			double const rate = wall > 0 ? c->n / wall : 0;
+			line << ", " << std::setprecision(c->decimals) << c->n << ' ' << c->unit << " (" << rate << ' ' << c->unit << "/s)";
+			args << ", \"" << c->unit << "\": " << c->n << ", \"" << c->unit << "/s\": " << rate;
+		} else {
+			line << ", " << std::setprecision(c->decimals) << c->n << " s " << c->unit;
+			args << ", \"" << c->unit << "_s\": " << c->n;
+		}
+	}
+	line << '\n';
+
+	// The memory at the end of the phase and the most used so far.
+	std::ostringstream counters;
+	double const rss = peak_rss() / 1e6;
+	line << std::setw(12) << "" << std::setprecision(1) << std::setw(8) << rss << " MB peak RSS";
+	counters << std::fixed << std::setprecision(3) << "\"rss_peak_MB\": " << rss;
+	for (int k = 0; k != MEM_KINDS; ++k) {
+		MemCount const    m    = mem_total((MemKind)k);
+		double const      peak = mem_peak((MemKind)k) / 1e6;
+		char const* const what = mem_name((MemKind)k);
+		line << ", " << m.n_objects << ' ' << what << ' ' << m.bytes / 1e6 << " MB (peak " << peak << " MB)";
+		counters << ", \"" << what << "_MB\": " << m.bytes / 1e6 << ", \"" << what << "_peak_MB\": " << peak;
+	}
+	line << '\n';
+	print(line);
+
+	if (trace_path) {
+		double const now = wall_ + wall;
+		events.push_back(new Event(name_, "phase",  'X', wall_, wall, main_thread, args.str() + ", " + counters.str()));
+		events.push_back(new Event("memory", "memory", 'C', now,   0,    main_thread, counters.str()));
+	}
+}
+
+void trace_print_stats()
+{
+	print_stats = true;
+}
+
+void trace_open(char const* const path)
+{
+	trace_path = path;
+}
+
+static std::string json_string(char const* s)
+{
+	static char const hex[] = "0123456789abcdef";
+	std::string j(1, '"');
+	for (; *s != '\0'; ++s) {
+		unsigned char const c = *s;
+		if (c == '"' || c == '\\') {
+			j += '\\';
+			j += c;
+		} else if (c < 0x20 || 0x7F <= c) {
+			// Bytes of other encodings are taken as Latin-1.
+			j += "\\u00";
+			j += hex[c >> 4];
+			j += hex[c & 0xF];
+		} else {
+			j += c;
+		}
+	}
+	return j += '"';
+}
+
+void trace_span(char const* const name, Span const& s, char const* const file)
+{
+	if (!trace_path) return;
+	events.push_back(new Event(name, "file", 'X', s.begin, s.seconds(), s.thread, "\"file\": " + json_string(file)));
+}
+
+static void write_trace(char const* const path)
+{
+	int const fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	if (fd < 0) throw std::runtime_error("cannot create trace file");
+
+	Output o(fd);
+	o << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+	for (Vector<Event*>::const_iterator i = events.begin(), end = events.end(); i != end; ++i) {
+		Event const& e = **i;
+		if (i != events.begin()) o << ",\n";
+		o << "{\"name\": \"" << e.name << "\", \"cat\": \"" << e.cat << "\", \"ph\": \"" << e.type << "\", \"pid\": 1, \"tid\": " << e.thread;
+		o << ", \"ts\": " << (u8)((e.begin - run_start) * 1e6);
+		if (e.type == 'X') o << ", \"dur\": " << (u8)(e.wall * 1e6);
+		o << ", \"args\": {" << e.args << "}}";
+	}
+	o << "\n]}\n";
+	o.flush();
+	if (close(fd) != 0) throw std::runtime_error("cannot write trace file");
+}
+
+void trace_finish()
+{
+	if (!trace_path) return;
+	// Only once, even if writing fails and the error path calls this again.
+	char const* const path = trace_path;
+	trace_path = 0;
+	write_trace(path);
+}
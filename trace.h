@@ -0,0 +1,84 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "types.h"
+
+// Seconds since an arbitrary point.
+double wall_time();
+
+// Seconds of CPU time used by all threads of the process.
+double cpu_time();
+
+/* The time one thread spent on one file.  Only the main thread hands spans
+ * to trace_span(), so the workers need no locking. */
+struct Span
+{
+	Span() : begin(), end(), thread() {}
+
+	void start();
+	void stop() { end = wall_time(); }
+
+	double seconds() const { return end - begin; }
+
+	double begin;
+	double end;
+	u4     thread; // Starting at 1 for the main thread
+};
+
+/* A phase of the run, timed from construction to end().  The counts yield
+ * the throughput in the summary of -p and the trace of -P. */
+class Phase
+{
+public:
+	explicit Phase(char const* name);
+
+	~Phase() { end(); }
+
+	// Adds the number of items processed, e.g. files, and their rate.
+	void count(char const* unit, double n);
+
+	// Adds the amount of data processed and its rate.
+	void bytes(double n);
+
+	// Adds time spent within the phase, summed over all threads.
+	void busy(char const* what, double seconds);
+
+	void end();
+
+private:
+	struct Count
+	{
+		char const* unit;
+		double      n;
+		int         decimals; // In the summary
+		bool        rate;
+	};
+
+	static size_t const MAX_COUNTS = 6;
+
+	void add(char const* unit, double n, int decimals, bool rate);
+
+	char const* const name_;
+	double const      wall_;
+	double const      cpu_;
+	bool              ended_;
+	Count             counts_[MAX_COUNTS];
+	size_t            n_counts_;
+
+	Phase(Phase const&);           // No copy
+	void operator =(Phase const&); // No assignment
+};
+
+// Print each phase to stderr, when it ends.
+void trace_print_stats();
+
+// Record the phases and the spans to write them as a trace at the end.
+void trace_open(char const* path);
+
+void trace_span(char const* name, Span const&, char const* file);
+
+/* Writes the trace, if requested.  Also called after an error, so failed runs
+ * leave a trace, too. */
+void trace_finish();
+
+#endif
@@ -3,8 +3,9 @@
 
 #include <cstddef>
 
-typedef unsigned char  u1;
-typedef unsigned short u2;
-typedef unsigned int   u4;
+typedef unsigned char      u1;
+typedef unsigned short     u2;
+typedef unsigned int       u4;
+typedef unsigned long long u8;
 
 #endif
@@ -21,6 +21,8 @@ public:
 
 	T* operator ->() const { return ptr_; }
 
+	T* get() const { return ptr_; }
+
 private:
 	uptr(uptr const&);
 
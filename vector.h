@@ -46,6 +46,8 @@ public:
 
 	size_t size() const { return size_; }
 
+	size_t capacity() const { return capacity_; }
+
 	iterator       begin()       { return data_; }
 	const_iterator begin() const { return data_; }
 
@@ -66,7 +68,7 @@ private:
 };
 
 template<typename T> Vector<T>::Vector(size_t const n) :
-	capacity_(n), size_(n), data_(new T[n]())
+	capacity_(n), size_(n), data_(static_cast<T*>(::operator new(n * sizeof(T))))
 {
 	for (T* i = data_, * const end = data_ + n; i != end; ++i) {
 		new(i) T();